@@ -1,14 +1,90 @@
 #ifndef INCLUDE_ANALYSIS_H
 #define INCLUDE_ANALYSIS_H
 
+#include <stdbool.h>
+
+#include "beat_events.h"
+#include "cqt.h"
 #include "dft.h"
+#include "filterbank.h"
 #include "pcm.h"
+#include "spectral_features.h"
+#include "tempo.h"
 
 struct Analysis_;
 typedef struct Analysis_* Analysis;
 
-Analysis create_analysis(Pcm pcm, DftData dft_data, unsigned int index);
-void compute_and_copy_analysis_to_gpu(DftData dft_data, Analysis analysis);
+// Most bands a layout can have.
+#define MAX_BANDS 64
+
+// Bands the DFT is summed over, band `i` spans `edges_hz[i]` to `edges_hz[i + 1]`.
+struct BandLayout {
+    int num_bands;
+    float edges_hz[MAX_BANDS + 1];
+};
+
+// The seven bands from sub-bass to brilliance.
+__attribute__((const)) struct BandLayout default_band_layout(void);
+
+// The arrays in `GpuData::bands`, in this order. There are `num_bands + 1`
+// edges and `num_bands` values of each of the others.
+enum BandValue {
+    BAND_EDGES_HZ,
+    BAND_ACCUMULATED,
+    BAND_WINDOW,
+    BAND_SMOOTH_WINDOW,
+    // second derivative
+    BAND_DELTA2,
+    BAND_MOVEMENT,
+};
+
+// Layout of the `analysis_data` block, using a struct here to align memory.
+// The shaders get the matching declaration from `glsl_of_analysis`.
+struct GpuData {
+    int is_beat;
+    int beats;
+    int bpm;
+    int other;
+
+    struct SpectralFeatures features;
+    // `bpm` above is this rounded.
+    struct TempoEstimate tempo;
+
+    int num_bands;
+    int other1, other2, other3;
+    // Structure of arrays, see `band_values_of_gpu_data`.
+    float bands[];
+};
+
+__attribute__((pure)) float const* band_values_of_gpu_data(struct GpuData const* data, enum BandValue value);
+
+// Snapshot of the detector state of one beat frequency, for debugging.
+struct BeatState {
+    int hz;
+    int cqt_index;
+    float noise_threshold;
+    float short_average;
+    float beat_threshold;
+    float current;
+    float sd_threshold;
+    bool is_beat;
+};
+
+// Beat onsets go to `beat_events`, the analysis is its producer.
+Analysis create_analysis(DftData dft_data, Cqt cqt, Filterbank filterbank, BeatEvents beat_events,
+                         struct BandLayout const* band_layout, unsigned int index);
+// Declaration of the `analysis_data` block and band helpers for the shaders, to be freed.
+char* glsl_of_analysis(Analysis analysis);
+// Analyses the current DFT frame only, `pcm` feeds the constant-Q transform.
+void analyze_dft_frame(Pcm pcm, DftData dft_data, Analysis analysis);
+void copy_analysis_to_gpu(Analysis analysis);
+// Uploads analysis results taken elsewhere, e.g. on another thread.
+void copy_analysis_data_to_gpu(Analysis analysis, struct GpuData const* data);
+__attribute__((pure)) struct GpuData const* gpu_data_of_analysis(Analysis analysis);
+// Size of the GPU data including the bands.
+__attribute__((pure)) int gpu_data_size_of_analysis(Analysis analysis);
+__attribute__((pure)) int num_beat_frequencies_of_analysis(Analysis analysis);
+__attribute__((pure)) struct BeatState beat_state_of_analysis(Analysis analysis, int beat_frequency_index);
 void delete_analysis(Analysis analysis);
 
 #endif
@@ -0,0 +1,37 @@
+#ifndef INCLUDE_BEAT_EVENTS_H
+#define INCLUDE_BEAT_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// `band` of the beats the tempo tracker predicts, the detectors use their index.
+#define BEAT_EVENT_TEMPO -1
+
+struct BeatEvent {
+    // Absolute sample index the event happened at.
+    uint64_t sample_index;
+    int band;
+    // 1 at the detection threshold, the tempo confidence for tempo beats.
+    float strength;
+};
+
+// Bounded lock-free queue of beat events from the analysis to the render loop,
+// a single producer and a single consumer. Each upload hands the shaders the
+// events since the previous one, so short beats between frames aren't lost.
+struct BeatEvents_;
+typedef struct BeatEvents_* BeatEvents;
+
+// Holds up to `capacity` events, also the most a single upload passes on.
+BeatEvents create_beat_events(int capacity, unsigned int index);
+
+// Producer side. Drops the event if the queue is full.
+bool push_beat_event(BeatEvents beat_events, struct BeatEvent event);
+
+// Consumer side.
+bool pop_beat_event(BeatEvents beat_events, struct BeatEvent* event);
+// Uploads all queued events, `sample_index` is the newest sample for the shaders to compare against.
+void copy_beat_events_to_gpu(BeatEvents beat_events, uint64_t sample_index);
+
+void delete_beat_events(BeatEvents beat_events);
+
+#endif
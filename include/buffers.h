@@ -4,17 +4,24 @@
 // For reference, see:
 // https://blog.techlab-xe.net/wp-content/uploads/2013/12/fig1_uniform_buffer.png
 
-struct Buffer_ {
-    unsigned int target; // GLenum
-    unsigned int buffer; // GLuint
-};
-typedef struct Buffer_ Buffer;
+struct Buffer_;
+typedef struct Buffer_* Buffer;
 
+// Written once or rarely, each copy goes straight to the GPU.
 Buffer create_uniform_buffer(int size, unsigned int index);
 Buffer create_storage_buffer(int size, unsigned int index);
 
-void copy_buffer_to_gpu(Buffer, void* data, int buffer_offset, int size);
-void copy_ringbuffer_to_gpu(Buffer, void* data, int buffer_offset, int size, int wrap_offset);
+// Rewritten every frame. Copies collect in a CPU side copy and
+// `commit_buffer_to_gpu` writes them to the next of a few persistently mapped
+// regions the GPU is done with, so uploads never wait on draws in flight.
+// Without GL 4.4 or ARB_buffer_storage these act like the ones above.
+Buffer create_streaming_uniform_buffer(int size, unsigned int index);
+Buffer create_streaming_storage_buffer(int size, unsigned int index);
+
+void copy_buffer_to_gpu(Buffer, void const* data, int buffer_offset, int size);
+// Makes the copies since the last commit visible to the shaders, does nothing for
+// the other buffers. Call it once after the copies of a frame.
+void commit_buffer_to_gpu(Buffer);
 void delete_buffer(Buffer);
 
 #endif
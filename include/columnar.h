@@ -0,0 +1,59 @@
+#ifndef INCLUDE_COLUMNAR_H
+#define INCLUDE_COLUMNAR_H
+
+#include <stdint.h>
+
+// A file of fixed-width columns that can be memory-mapped as is.
+//
+// All values are little endian. The file starts with a `ColumnarHeader`,
+// followed by `num_columns` `ColumnHeader`s. Each column is a contiguous,
+// 64 byte aligned array of `num_rows * width` values, starting at `offset`.
+// There may be unused capacity after the last row of each column.
+
+#define COLUMNAR_MAGIC "OSCCOLS"
+#define COLUMNAR_VERSION 1
+
+enum ColumnType {
+    COLUMN_TYPE_F32,
+    COLUMN_TYPE_I32,
+    COLUMN_TYPE_U64,
+};
+
+struct ColumnarHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_columns;
+    uint64_t num_rows;
+    uint32_t sample_rate;
+    uint32_t hop_size;
+    uint32_t dft_size;
+    uint32_t reserved[7];
+};
+
+struct ColumnHeader {
+    char name[40];
+    uint32_t type;
+    // Number of values per row.
+    uint32_t width;
+    uint64_t offset;
+    uint64_t reserved;
+};
+
+struct ColumnSpec {
+    char const* name;
+    enum ColumnType type;
+    int width;
+};
+
+struct Columnar_;
+typedef struct Columnar_* Columnar;
+
+// Create a file with room for `max_rows` rows.
+Columnar create_columnar(char const* path, struct ColumnSpec const* specs, int num_columns, uint64_t max_rows,
+                         struct ColumnarHeader metadata);
+// Address of the first value of `column` in `row`.
+__attribute__((pure)) void* columnar_cell(Columnar columnar, int column, uint64_t row);
+void set_columnar_num_rows(Columnar columnar, uint64_t num_rows);
+void delete_columnar(Columnar columnar);
+
+#endif
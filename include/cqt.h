@@ -0,0 +1,27 @@
+#ifndef INCLUDE_CQT_H
+#define INCLUDE_CQT_H
+
+#include "dft.h"
+#include "pcm.h"
+
+// Constant-Q magnitudes of the mid channel, log spaced from `min_hz` up. Bins get
+// narrower towards the bass instead of the 10.8 Hz of the DFT, see cqt.c.
+struct Cqt_;
+typedef struct Cqt_* Cqt;
+
+Cqt create_cqt(DftData dft_data, int bins_per_octave, float min_hz, enum DftPlanning planning, unsigned int index);
+
+__attribute__((pure)) int num_bins_of_cqt(Cqt cqt);
+__attribute__((pure)) float frequency_of_cqt_bin(Cqt cqt, int bin);
+// Nearest bin, clamped to the range.
+__attribute__((pure)) int cqt_bin_of_frequency(Cqt cqt, float hz);
+__attribute__((pure)) float const* magnitudes_of_cqt(Cqt cqt);
+
+// Transforms the window ending with the current DFT frame.
+void compute_cqt(Pcm pcm, DftData dft_data, Cqt cqt);
+void copy_cqt_to_gpu(Cqt cqt);
+// Uploads `num_bins_of_cqt` magnitudes taken elsewhere, e.g. on another thread.
+void copy_cqt_magnitudes_to_gpu(Cqt cqt, float const* magnitudes);
+void delete_cqt(Cqt cqt);
+
+#endif
@@ -1,16 +1,66 @@
 #ifndef INCLUDE_DFT_H
 #define INCLUDE_DFT_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "pcm.h"
 
 struct DftData_;
 typedef struct DftData_* DftData;
 
-DftData create_dft_data(int dft_size, unsigned int index);
+// How long FFTW searches for the fastest plan, from FFTW_ESTIMATE to FFTW_EXHAUSTIVE.
+enum DftPlanning {
+    DFT_PLANNING_ESTIMATE,
+    DFT_PLANNING_MEASURE,
+    DFT_PLANNING_PATIENT,
+    DFT_PLANNING_EXHAUSTIVE,
+};
+
+// The FFTW_ESTIMATE... flag for `planning`.
+__attribute__((const)) unsigned int fftw_flags_of_planning(enum DftPlanning planning);
+
+// FFTW wisdom remembers the plans found per size, kind and planning level on this machine.
+bool load_dft_wisdom(char const* path);
+bool save_dft_wisdom(char const* path);
+
+// Magnitude sections of a frame, in GPU order. Mono only has the mid one.
+enum DftChannel {
+    DFT_CHANNEL_MID,
+    DFT_CHANNEL_LEFT,
+    DFT_CHANNEL_RIGHT,
+    DFT_CHANNEL_SIDE,
+};
+
+// Short-time transform of the PCM, one frame every `hop_size` samples.
+// Stereo costs one complex transform of `dft_size` per frame.
+DftData create_dft_data(int dft_size, int hop_size, int sample_rate, bool stereo, enum DftPlanning planning,
+                        unsigned int index);
 
 __attribute__((pure)) int size_of_dft(DftData const dft_data);
+__attribute__((pure)) int sample_rate_of_dft(DftData const dft_data);
+__attribute__((pure)) int hop_size_of_dft(DftData const dft_data);
+// End of the window of the current frame.
+__attribute__((pure)) uint64_t sample_index_of_dft(DftData const dft_data);
+__attribute__((pure)) uint64_t dropped_frames_of_dft(DftData const dft_data);
+__attribute__((pure)) int num_channels_of_dft(DftData const dft_data);
+// The `size / 2 + 1` magnitudes of one channel of the current frame.
+__attribute__((pure)) float const* channel_magnitudes_of_dft(DftData const dft_data, enum DftChannel channel);
+// Same for the mid channel, (left + right) / 2.
+__attribute__((pure)) float const* magnitudes_of_dft(DftData const dft_data);
 __attribute__((pure)) float dft_at(DftData const dft_data, int index);
-void compute_and_copy_dft_data_to_gpu(Pcm pcm, DftData dft_data);
+// Mid magnitudes of the `frame`th of the frames queued by the last `compute_dft_frames`,
+// whether or not `next_dft_frame` got to it yet.
+__attribute__((pure)) float const* queued_magnitudes_of_dft(DftData const dft_data, int frame);
+// Transforms every hop that completed since the last call, returns the number of queued frames.
+int compute_dft_frames(Pcm pcm, DftData dft_data);
+// Steps to the next queued frame, false once all were visited.
+bool next_dft_frame(DftData dft_data);
+// All channel sections of the newest frame, `num_channels * (size / 2 + 1)` floats.
+__attribute__((pure)) float const* newest_magnitudes_of_dft(DftData const dft_data);
+void copy_dft_data_to_gpu(DftData dft_data);
+// Uploads magnitudes laid out like `newest_magnitudes_of_dft`, e.g. a copy taken on another thread.
+void copy_dft_magnitudes_to_gpu(DftData dft_data, float const* magnitudes);
 void delete_dft_data(DftData dft_data);
 
 #endif
@@ -0,0 +1,32 @@
+#ifndef INCLUDE_FILTERBANK_H
+#define INCLUDE_FILTERBANK_H
+
+#include "dft.h"
+
+enum FilterbankScale {
+    FILTERBANK_MEL,
+    FILTERBANK_LOG,
+    FILTERBANK_BARK,
+};
+
+// Triangular bands spaced evenly on a perceptual scale, mapped from the DFT
+// magnitudes by a sparse weight matrix that is built once.
+struct Filterbank_;
+typedef struct Filterbank_* Filterbank;
+
+Filterbank create_filterbank(DftData dft_data, int num_bands, enum FilterbankScale scale, float min_hz, float max_hz,
+                             unsigned int index);
+
+__attribute__((pure)) int num_bands_of_filterbank(Filterbank filterbank);
+// Center frequency of `band`.
+__attribute__((pure)) float frequency_of_filterbank_band(Filterbank filterbank, int band);
+__attribute__((pure)) float const* bands_of_filterbank(Filterbank filterbank);
+
+// Maps the mid magnitudes of the current DFT frame.
+void compute_filterbank(DftData dft_data, Filterbank filterbank);
+void copy_filterbank_to_gpu(Filterbank filterbank);
+// Uploads `num_bands_of_filterbank` bands taken elsewhere, e.g. on another thread.
+void copy_filterbank_bands_to_gpu(Filterbank filterbank, float const* bands);
+void delete_filterbank(Filterbank filterbank);
+
+#endif
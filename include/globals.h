@@ -16,5 +16,7 @@
 #define FORI(lo, hi) for(int i=(lo); i<(hi); i++)
 
 __attribute__((const)) float mix(float a, float b, float x);
+// Wall clock seconds since some arbitrary point.
+double get_monotonic_seconds(void);
 
 #endif
@@ -0,0 +1,26 @@
+#ifndef INCLUDE_GOVERNOR_H
+#define INCLUDE_GOVERNOR_H
+
+#include <stdbool.h>
+
+#include "size.h"
+
+// Lowers the resolution the programs render at while the GPU takes longer than
+// the frame budget, and raises it again once there is room. The GPU times come
+// from timer queries that are read a few frames late, so nothing waits on them.
+// A new resolution clears the images, the scale changes seldom and in steps.
+struct Governor_;
+typedef struct Governor_* Governor;
+
+// Renders at `max_scale` times the window size at most, and always with a
+// `frame_budget_s` of 0. With `stats` it prints the scale every few seconds.
+Governor create_governor(double frame_budget_s, float max_scale, bool stats);
+// Around the dispatches of a frame.
+void begin_governed_frame(Governor governor);
+void end_governed_frame(Governor governor);
+__attribute__((pure)) float render_scale_of_governor(Governor governor);
+// Size of the images for a window, the dispatches round it up to whole work groups.
+__attribute__((pure)) struct Size render_size_of_governor(Governor governor, struct Size window_size);
+void delete_governor(Governor governor);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef INCLUDE_INTERLEAVE_H
+#define INCLUDE_INTERLEAVE_H
+
+#include "size.h"
+
+// Renders only every `factor`th pixel per frame in a rotating pattern: a
+// checkerboard for 2, one pixel of each 2x2 block for 4. The shaders map their
+// invocations with `interleaved_pixel`, `reconstruct.comp` fills in the rest
+// from the previous frames.
+struct Interleave_;
+typedef struct Interleave_* Interleave;
+
+// `factor` is 1, 2 or 4, 1 renders every pixel.
+Interleave create_interleave(int factor, unsigned int index);
+// Moves on to the next pattern, once per frame before the programs run.
+void advance_interleave(Interleave interleave);
+// The pattern of the current frame, `interleave_phase` in the shaders.
+__attribute__((pure)) int phase_of_interleave(Interleave interleave);
+// Invocations that cover the pattern of `size`, for the program and `reconstruct.comp`.
+__attribute__((pure)) struct Size dispatch_size_of_interleave(Interleave interleave, struct Size size);
+void delete_interleave(Interleave interleave);
+
+#endif
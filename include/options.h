@@ -0,0 +1,66 @@
+#ifndef INCLUDE_OPTIONS_H
+#define INCLUDE_OPTIONS_H
+
+#include <stdbool.h>
+
+#include "analysis.h"
+#include "dft.h"
+#include "filterbank.h"
+#include "pcm_format.h"
+
+struct Options {
+    // Format of the raw PCM data on stdin or in a headerless input file.
+    struct PcmFormat pcm_format;
+    // Read from this file instead of stdin, NULL for stdin.
+    char const* input_path;
+    // Process the input file as fast as possible, one hop at a time.
+    bool offline;
+    // Number of samples between DFT frames, also the step of offline mode.
+    int hop_size;
+    // Number of new samples to wait for before analysing a frame.
+    int wake_samples;
+    // Transform left and right separately instead of their mix.
+    bool stereo;
+    // Resolution of the constant-Q transform the beat detection runs on.
+    int cqt_bins_per_octave;
+    // Perceptual bands mapped from the DFT for the shaders.
+    int filterbank_bands;
+    enum FilterbankScale filterbank_scale;
+    // Bands the shaders get summed magnitudes of.
+    struct BandLayout band_layout;
+    // How long FFTW may search for fast DFT plans.
+    enum DftPlanning planning;
+    // File to load FFTW wisdom from and save it to, NULL to plan from scratch every time.
+    char const* wisdom_path;
+    // GPU time per frame the render resolution is lowered to meet, 0 to keep it.
+    double frame_budget_s;
+    // Render resolution relative to the window, the most the budget allows.
+    float render_scale;
+    // Render every `interleave`th pixel per frame and fill in the rest, 1, 2 or 4.
+    int interleave;
+    // Print the timings of the analysis thread and the uploads, and the render scale.
+    bool stats;
+};
+
+// `value` as a whole number from `min` to `max`. Otherwise prints the error and the
+// usage and exits.
+int parse_int_option(char const* program_name, char const* value, int min, int max,
+                     void (*print_program_usage)(char const* program_name));
+
+// Look up a sample format by name, as used by parec.
+bool parse_sample_format(char const* value, enum SampleFormat* format);
+
+bool parse_dft_planning(char const* value, enum DftPlanning* planning);
+
+bool parse_filterbank_scale(char const* value, enum FilterbankScale* scale);
+
+// Either increasing edges in Hz separated by commas, or a number of log spaced bands.
+bool parse_band_edges(char const* value, struct BandLayout* layout);
+
+// Per-machine wisdom file in the user's cache directory, NULL without a home.
+char const* default_wisdom_path(void);
+
+// Parse the command line, print the usage and exit on invalid input.
+struct Options parse_options(int argc, char* argv[]);
+
+#endif
@@ -1,13 +1,48 @@
 #ifndef INCLUDE_PCM_H
 #define INCLUDE_PCM_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pcm_format.h"
+
 struct Pcm_;
 typedef struct Pcm_* Pcm;
 
-Pcm create_pcm(int num_samples, unsigned int index);
-__attribute__((const)) int sample_rate_of_pcm(Pcm pcm);
+// Half-open range `[start, end)` of absolute sample indices.
+struct PcmWindow {
+    uint64_t start;
+    uint64_t end;
+};
+
+struct PcmStats {
+    // Number of times the reader fell more than a ring length behind.
+    uint64_t xruns;
+    // Samples that were overwritten before they were consumed.
+    uint64_t dropped_samples;
+    // Copies that were overwritten by the producer while reading.
+    uint64_t torn_reads;
+};
+
+Pcm create_pcm(int num_samples, struct PcmFormat format, unsigned int index);
+__attribute__((pure)) int sample_rate_of_pcm(Pcm pcm);
+__attribute__((pure)) struct PcmFormat format_of_pcm(Pcm pcm);
+
+// Producer side. Only ever call these from a single thread.
+// `interleaved` holds `num_samples` frames of `format.channels` floats.
+void write_pcm_samples(Pcm pcm, float const* interleaved, int num_samples);
+
+// Consumer side. Only ever call these from a single thread.
+uint64_t pcm_sample_index(Pcm pcm);
+// Sleep until `num_samples` unconsumed samples are available or `timeout_ms` passed.
+bool wait_for_pcm_samples(Pcm pcm, int num_samples, int timeout_ms);
+struct PcmWindow consume_pcm(Pcm pcm);
+bool copy_pcm_window(Pcm pcm, uint64_t end, int num_samples, float* left, float* right);
+struct PcmStats get_pcm_stats(Pcm pcm);
+// Safe from any one thread besides the consumer, it touches no consumer state.
+// Only the samples since the previous call go up, `pcm_data` is a ring too.
 void copy_pcm_to_gpu(Pcm pcm);
-void copy_pcm_mono_to_buffer(float* dst, Pcm pcm, int num_floats);
+
 void delete_pcm(Pcm pcm);
 
 struct PcmStream_;
@@ -0,0 +1,27 @@
+#ifndef INCLUDE_PCM_FILE_H
+#define INCLUDE_PCM_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pcm.h"
+#include "pcm_format.h"
+
+struct PcmFile_;
+typedef struct PcmFile_* PcmFile;
+
+// Memory-map a WAV, Sun AU or raw PCM file. Headerless files are assumed to
+// be in `raw_format`.
+PcmFile create_pcm_file(char const* path, struct PcmFormat raw_format);
+__attribute__((pure)) struct PcmFormat format_of_pcm_file(PcmFile pcm_file);
+__attribute__((pure)) uint64_t num_samples_of_pcm_file(PcmFile pcm_file);
+__attribute__((pure)) bool pcm_file_finished(PcmFile pcm_file);
+
+// Write the next `num_samples` samples to `pcm`, returns how many were left.
+int advance_pcm_file(PcmFile pcm_file, Pcm pcm, int num_samples);
+// Write all samples that are due since the first call in real time.
+int play_pcm_file(PcmFile pcm_file, Pcm pcm);
+
+void delete_pcm_file(PcmFile pcm_file);
+
+#endif
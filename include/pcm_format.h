@@ -0,0 +1,20 @@
+#ifndef INCLUDE_PCM_FORMAT_H
+#define INCLUDE_PCM_FORMAT_H
+
+// Raw input sample encodings, all little endian and interleaved.
+enum SampleFormat {
+    SAMPLE_FORMAT_U8,
+    SAMPLE_FORMAT_S16LE,
+    // Packed, 3 bytes per value.
+    SAMPLE_FORMAT_S24LE,
+    SAMPLE_FORMAT_S32LE,
+    SAMPLE_FORMAT_F32LE,
+};
+
+struct PcmFormat {
+    enum SampleFormat sample_format;
+    int channels;
+    int sample_rate;
+};
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef INCLUDE_PIPELINE_H
+#define INCLUDE_PIPELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "analysis.h"
+#include "dft.h"
+#include "pcm.h"
+#include "spectrogram.h"
+
+// Runs the DFT and the analysis on a worker thread as the audio arrives, the
+// render thread only uploads the newest complete results. The worker owns the
+// consumer side of `pcm` and everything it analyses from then on.
+struct Pipeline_;
+typedef struct Pipeline_* Pipeline;
+
+// Cumulative worker timings, they travel with the snapshots.
+struct PipelineTimings {
+    uint64_t hops;
+    uint64_t publishes;
+    double dft_s;
+    double analysis_s;
+    double publish_s;
+};
+
+// Starts the worker, it wakes up for every `wake_samples` new samples. With
+// `stats` the render thread prints the stage timings every few seconds.
+Pipeline create_pipeline(Pcm pcm, DftData dft_data, Cqt cqt, Filterbank filterbank, Analysis analysis,
+                         Spectrogram spectrogram, int wake_samples, bool stats);
+// Render thread, uploads the newest results if there are new ones.
+void copy_pipeline_to_gpu(Pipeline pipeline);
+// Render thread, the timings of the results uploaded last.
+__attribute__((pure)) struct PipelineTimings timings_of_pipeline(Pipeline pipeline);
+// Stops and joins the worker.
+void delete_pipeline(Pipeline pipeline);
+
+#endif
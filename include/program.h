@@ -5,20 +5,35 @@
 #include <time.h>
 #include <stdbool.h>
 
+#include "textures.h"
+
 struct Program_;
 typedef struct Program_* Program;
 
-// Initialize and install a program.
-Program create_program(char const* compute_shader_path);
+// Initialize and install a program. `prelude` goes right after the `#version` line
+// of the shader source, it has to outlive the program.
+Program create_program(char const* compute_shader_path, char const* prelude);
 
 // Check if the program source has been modified since last read.
 bool program_source_modified(Program program);
 
 // Try to compile and install a program, keep the old one if something fails.
-void reinstall_program_if_valid(Program program);
+// The images it uses are the `layout(<format>, binding = <unit>) uniform image2D`
+// lines the compiler keeps. True if a new program got installed.
+bool reinstall_program_if_valid(Program program);
 
 // Combine the modified check and validity check.
-void reinstall_program_if_modified(Program program);
+bool reinstall_program_if_modified(Program program);
+
+// Go back to the program the last reinstall replaced, e.g. when the new one's images
+// don't fit with the other programs. False if there is none.
+bool restore_previous_program(Program program);
+
+// Add the images the installed program uses, false if another program declared one differently.
+bool add_program_image_formats(Program program, struct ImageFormats* image_formats);
+
+// Whether the installed program declares the uniform block `name` and uses it.
+bool program_uses_uniform_block(Program program, char const* name);
 
 // Run the program and wait for completion.
 void run_program(Program program, GLuint w, GLuint h);
@@ -0,0 +1,18 @@
+#ifndef INCLUDE_RING_BUFFER_H
+#define INCLUDE_RING_BUFFER_H
+
+#include <stdint.h>
+
+// A ring buffer whose memory is mapped twice back to back, so that any span
+// of up to `size` bytes starting anywhere in the ring is contiguous.
+struct RingBuffer_;
+typedef struct RingBuffer_* RingBuffer;
+
+// The size is rounded up to a multiple of the page size.
+RingBuffer create_ring_buffer(int min_size);
+__attribute__((pure)) int size_of_ring_buffer(RingBuffer ring_buffer);
+// Address of byte `index % size`, valid for `size` bytes.
+__attribute__((pure)) void* ring_buffer_at(RingBuffer ring_buffer, uint64_t index);
+void delete_ring_buffer(RingBuffer ring_buffer);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef INCLUDE_SIMD_H
+#define INCLUDE_SIMD_H
+
+// Vectorized kernels. SSE2 is the baseline on x86-64, AVX2 is picked at
+// runtime if the CPU supports it. Other architectures use the scalar loops.
+
+#include <stdbool.h>
+
+#include "pcm_format.h"
+
+__attribute__((const)) int bytes_per_value(enum SampleFormat format);
+
+// Convert `num_values` raw values to floats in [-1, 1].
+void convert_to_float(enum SampleFormat format, void const* src, float* dst, int num_values);
+
+// Split `num_samples` interleaved stereo samples into two channels.
+void deinterleave_stereo(float const* interleaved, float* left, float* right, int num_samples);
+// Pick the first two of `num_channels` interleaved channels, mono is copied to both.
+void deinterleave_channels(float const* interleaved, int num_channels, float* left, float* right, int num_samples);
+
+// dst = src * window, `dst` may be `src`.
+void multiply_window(float const* src, float const* window, float* dst, int num_values);
+// dst = (left + right) / 2 * window.
+void mix_window(float const* left, float const* right, float const* window, float* dst, int num_values);
+// Complex `dst` with windowed left as the real and windowed right as the imaginary parts.
+void interleave_window(float const* left, float const* right, float const* window, float* dst, int num_values);
+// Magnitudes of the `size / 2 + 1` bins of an FFTW_R2HC output of even `size`.
+void halfcomplex_magnitudes(float const* halfcomplex, int size, float* magnitudes);
+// One pass of sums over a magnitude spectrum for the spectral features,
+// `k` being the bin index.
+struct SpectrumSums {
+    float sum;
+    // Sum of k * m.
+    float weighted_sum;
+    // Sum of k^2 * m.
+    float square_weighted_sum;
+    // Sum of log2(m + 1e-10), good to about 1e-5 per value in the vectorized kernels.
+    float log2_sum;
+    float max;
+    // Sum of max(0, m - previous m).
+    float rectified_flux;
+};
+void spectrum_sums(float const* magnitudes, float const* previous, int num_values, struct SpectrumSums* sums);
+// y = A x for a CSR matrix A, row `i` has the `values` and `columns` from
+// `row_offsets[i]` to `row_offsets[i + 1]`.
+void sparse_matrix_vector(int num_rows, int const* row_offsets, int const* columns, float const* values, float const* x,
+                          float* y);
+
+// The variants behind the dispatch, for the tests and benchmarks. The ranged
+// ones work on `[first, last)` and `spectrum_sums_*` add to `sums`.
+void deinterleave_stereo_scalar(float const* interleaved, float* left, float* right, int num_samples);
+void mix_window_scalar(float const* left, float const* right, float const* window, float* dst, int num_values);
+void halfcomplex_magnitudes_scalar(float const* halfcomplex, int size, float* magnitudes, int first, int last);
+void sparse_matrix_vector_scalar(int num_rows, int const* row_offsets, int const* columns, float const* values,
+                                 float const* x, float* y);
+void spectrum_sums_scalar(float const* magnitudes, float const* previous, int first, int last,
+                          struct SpectrumSums* sums);
+#if defined(__x86_64__)
+__attribute__((pure)) bool has_avx2(void);
+void deinterleave_stereo_sse2(float const* interleaved, float* left, float* right, int num_samples);
+__attribute__((target("avx2"))) void deinterleave_stereo_avx2(float const* interleaved, float* left, float* right,
+                                                              int num_samples);
+void mix_window_sse2(float const* left, float const* right, float const* window, float* dst, int num_values);
+__attribute__((target("avx2"))) void mix_window_avx2(float const* left, float const* right, float const* window,
+                                                     float* dst, int num_values);
+void halfcomplex_magnitudes_sse2(float const* halfcomplex, int size, float* magnitudes, int first, int last);
+__attribute__((target("avx2"))) void halfcomplex_magnitudes_avx2(float const* halfcomplex, int size,
+                                                                 float* magnitudes, int first, int last);
+__attribute__((target("avx2"))) void sparse_matrix_vector_avx2(int num_rows, int const* row_offsets,
+                                                               int const* columns, float const* values,
+                                                               float const* x, float* y);
+void spectrum_sums_sse2(float const* magnitudes, float const* previous, int first, int last,
+                        struct SpectrumSums* sums);
+__attribute__((target("avx2"))) void spectrum_sums_avx2(float const* magnitudes, float const* previous, int first,
+                                                        int last, struct SpectrumSums* sums);
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef INCLUDE_SPECTRAL_FEATURES_H
+#define INCLUDE_SPECTRAL_FEATURES_H
+
+// Shape of one magnitude spectrum, part of the `analysis_data` block.
+struct SpectralFeatures {
+    // Summed increase of the magnitudes since the previous frame.
+    float flux;
+    // Center of mass in Hz, the brightness.
+    float centroid;
+    // Standard deviation around the centroid in Hz.
+    float spread;
+    // Frequency below which 85% of the magnitudes lie.
+    float rolloff;
+    // Geometric over arithmetic mean, 1 for white noise and near 0 for tones.
+    float flatness;
+    // Peak over arithmetic mean.
+    float crest;
+    float other1, other2;
+};
+
+// `previous` are the magnitudes of the frame before, `bin_hz` the bin spacing.
+void compute_spectral_features(float const* magnitudes, float const* previous, int num_bins, float bin_hz,
+                               struct SpectralFeatures* features);
+
+#endif
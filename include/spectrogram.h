@@ -0,0 +1,20 @@
+#ifndef INCLUDE_SPECTROGRAM_H
+#define INCLUDE_SPECTROGRAM_H
+
+#include "dft.h"
+
+// History of the mid DFT magnitudes on the GPU, one texture row per frame.
+// The rows form a ring, the row written next goes to the shaders in a uniform block.
+struct Spectrogram_;
+typedef struct Spectrogram_* Spectrogram;
+
+Spectrogram create_spectrogram(DftData dft_data, int num_rows, unsigned int index, unsigned int texture_unit);
+
+// Appends the `num_frames` frames the last `compute_dft_frames` returned. May
+// run on another thread than the upload, but only ever on the same one.
+void add_spectrogram_rows(Spectrogram spectrogram, DftData dft_data, int num_frames);
+// Uploads the rows added since the last call.
+void copy_spectrogram_to_gpu(Spectrogram spectrogram);
+void delete_spectrogram(Spectrogram spectrogram);
+
+#endif
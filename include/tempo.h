@@ -0,0 +1,25 @@
+#ifndef INCLUDE_TEMPO_H
+#define INCLUDE_TEMPO_H
+
+// Tempo of the music, part of the `analysis_data` block.
+struct TempoEstimate {
+    // 0 until there was a periodic onset envelope.
+    float bpm;
+    // Position within the beat, 0 on the beat and rising towards 1.
+    float phase;
+    // How periodic the onsets are, 0 to 1.
+    float confidence;
+    float other;
+};
+
+// Tracks the tempo of an onset strength envelope sampled once per hop. Every
+// hop costs one multiply-add per candidate period, there is no per-window FFT.
+struct Tempo_;
+typedef struct Tempo_* Tempo;
+
+Tempo create_tempo(int sample_rate, int hop_size);
+// Adds the onset strength of the next hop, e.g. the spectral flux.
+void add_tempo_onset(Tempo tempo, float onset, struct TempoEstimate* estimate);
+void delete_tempo(Tempo tempo);
+
+#endif
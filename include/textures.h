@@ -1,15 +1,42 @@
 #ifndef INCLUDE_TEXTURES_H
 #define INCLUDE_TEXTURES_H
 
+#include <stdbool.h>
+
 #include <SDL2/SDL_opengl.h>
 
 #include "size.h"
 
+// Image units the shaders see. The back and front image of a pair swap every
+// frame, so they share a format.
+enum Image {
+    IMAGE_PRESENT,
+    IMAGE_BACK_A,
+    IMAGE_FRONT_A,
+    IMAGE_BACK_B,
+    IMAGE_FRONT_B,
+    IMAGE_BACK_C,
+    IMAGE_FRONT_C,
+    NUM_IMAGES,
+};
+
+// Internal format of each image, 0 for the ones no shader uses.
+struct ImageFormats {
+    GLenum formats[NUM_IMAGES];
+};
+
+// Requires `format` for `image` and its pair. False if it already has a different one.
+bool add_image_format(struct ImageFormats* image_formats, enum Image image, GLenum format);
+
 typedef struct Textures_* Textures;
 
-Textures create_textures(struct Size size);
+// Only the images with a format get allocated, `present` always is.
+Textures create_textures(struct Size size, struct ImageFormats const* image_formats);
 void swap_and_bind_textures(Textures textures);
+// Reallocates the images at `size`, they start out cleared like on creation.
 void update_textures_window_size(Textures textures, struct Size size);
+// Reallocates the images if the formats changed, e.g. after a shader was edited.
+void update_texture_formats(Textures textures, struct ImageFormats const* image_formats);
 void delete_textures(Textures textures);
 __attribute__((pure)) GLuint get_present_texture(Textures textures);
 
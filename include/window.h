@@ -11,7 +11,8 @@ struct Window_;
 typedef struct Window_* Window;
 
 Window create_window(struct Size size);
-void display_texture(Window window, GLuint texture, struct Size size);
+// Shows `texture` of `texture_size` stretched over the `size` of the window.
+void display_texture(Window window, GLuint texture, struct Size texture_size, struct Size size);
 struct Size get_window_size(Window window);
 void delete_window(Window window);
 
@@ -1,40 +1,45 @@
-import pandas as pd
+import sys
+import numpy as np
 import matplotlib.pyplot as plt
 
-data = pd.read_csv('long.csv')
+# Reads the columnar file written by oscilloscope-visualizer_headless,
+# see include/columnar.h for the layout
+TYPES = {0: np.float32, 1: np.int32, 2: np.uint64}
 
-sample = data[["Sample"]]
-cols = ["hz","idx","noize","avg","thresh","cur","sd","is_beat"]
+def read_columnar(path):
+    raw = np.memmap(path, dtype=np.uint8, mode='r')
+    header = raw[:64]
+    if bytes(header[:8]) != b'OSCCOLS\0':
+        sys.exit(path + ' is not a columnar results file')
+    num_columns, num_rows = header[12:16].view(np.uint32)[0], header[16:24].view(np.uint64)[0]
+    columns = {}
+    for i in range(num_columns):
+        column = raw[64 + 64 * i:128 + 64 * i]
+        name = bytes(column[:40]).split(b'\0')[0].decode()
+        type, width = column[40:48].view(np.uint32)
+        offset = column[48:56].view(np.uint64)[0]
+        dtype = TYPES[int(type)]
+        size = int(num_rows) * int(width) * np.dtype(dtype).itemsize
+        columns[name] = raw[offset:offset + size].view(dtype).reshape(int(num_rows), int(width))
+    return columns
 
-ax1 = plt.subplot(3, 1, 1)
-data1_cols = [x + "1" for x in cols]
-ax1.plot(sample, data[["noize1"]], label="noize")
-ax1.plot(sample, data[["avg1"]], label="avg")
-ax1.plot(sample, data[["thresh1"]], label="thresh")
-ax1.plot(sample, data[["cur1"]], label="cur")
-ax1.plot(sample, data[["sd1"]], label="sd")
-ax1.legend()
-ax1_ = ax1.twinx()
-ax1_.plot(sample, data[["is_beat1"]], label="beat?", marker=".")
+data = read_columnar(sys.argv[1] if len(sys.argv) > 1 else 'results.col')
 
-ax2 = plt.subplot(3, 1, 2, sharex=ax1, sharey=ax1)
-ax2.plot(sample, data[["noize2"]], label="noize")
-ax2.plot(sample, data[["avg2"]], label="avg")
-ax2.plot(sample, data[["thresh2"]], label="thresh")
-ax2.plot(sample, data[["cur2"]], label="cur")
-ax2.plot(sample, data[["sd2"]], label="sd")
-ax2.legend()
-ax2_ = ax2.twinx()
-ax2_.plot(sample, data[["is_beat2"]], label="beat?", marker=".")
+sample = data["sample_index"][:, 0]
+hz = data["beat.hz"][0] if len(sample) > 0 else []
 
-ax3 = plt.subplot(3, 1, 3, sharex=ax1, sharey=ax1)
-ax3.plot(sample, data[["noize3"]], label="noize")
-ax3.plot(sample, data[["avg3"]], label="avg")
-ax3.plot(sample, data[["thresh3"]], label="thresh")
-ax3.plot(sample, data[["cur3"]], label="cur")
-ax3.plot(sample, data[["sd3"]], label="sd")
-ax3.legend()
-ax3_ = ax3.twinx()
-ax3_.plot(sample, data[["is_beat3"]], label="beat?", marker=".")
+ax1 = None
+for i in range(data["beat.hz"].shape[1]):
+    ax = plt.subplot(len(hz), 1, i + 1, sharex=ax1, sharey=ax1)
+    ax1 = ax1 or ax
+    ax.set_title(str(hz[i]) + " Hz")
+    ax.plot(sample, data["beat.noise_threshold"][:, i], label="noize")
+    ax.plot(sample, data["beat.short_average"][:, i], label="avg")
+    ax.plot(sample, data["beat.threshold"][:, i], label="thresh")
+    ax.plot(sample, data["beat.current"][:, i], label="cur")
+    ax.plot(sample, data["beat.sd_threshold"][:, i], label="sd")
+    ax.legend()
+    ax_ = ax.twinx()
+    ax_.plot(sample, data["beat.is_beat"][:, i], label="beat?", marker=".")
 
 plt.show()
@@ -2,36 +2,56 @@
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <time.h>
+#include <string.h>
 
 #include <fftw3.h>
 
 #include "analysis.h"
 #include "buffers.h"
+#include "cqt.h"
+#include "filterbank.h"
 #include "globals.h"
 #include "dft.h"
-#include "pcm.h"
+#include "spectral_features.h"
 
-static int const frequencies[8] = {16, 60, 250, 500, 2000, 4000, 6000, 22000};
+__attribute__((const)) struct BandLayout default_band_layout(void) {
+    return (struct BandLayout){
+        .num_bands = 7,
+        .edges_hz = {16, 60, 250, 500, 2000, 4000, 6000, 22000},
+    };
+}
 
 struct Analysis_ {
     int sample_rate;
     int dft_size;
-
-    int frequency_indices[8];
+    // Beats are detected on constant-Q bins, the DFT is too coarse in the bass.
+    Cqt cqt;
+    // Perceptual bands for the shaders, mapped once per frame.
+    Filterbank filterbank;
+
+    // DFT bins from `band_bins[i]` up to `band_bins[i + 1]` make up band `i`.
+    int num_bands;
+    int band_bins[MAX_BANDS + 1];
+
+    // Mid magnitudes of the previous frame, for the flux.
+    float* previous_magnitudes;
+    // Runs on the flux, one onset per hop.
+    Tempo tempo;
+    // Beats as they start, detector and tempo alike.
+    BeatEvents beat_events;
 
     /* BEAT DETECTION */
     int num_beat_frequencies;
 
-    // Time of last beat detection: t0.
-    time_t last_time;
-    // Duration between runs of beat_detection: delta = E[t1 - t0].
-    // Used to adjust the amount of samples for the short term average.
-    float moving_average_process_time_ms;
-    // Desired duration of the short average: T.
-    float short_average_window_ms;
-    // Number of samples to reach desired average duration: T / delta.
+    // Sample index of the last analysed DFT window. Timing follows the audio,
+    // one history slot per hop, so results don't depend on the frame rate.
+    uint64_t last_sample_index;
+    // Duration of the short average in audio seconds: T.
+    float short_average_window_s;
+    // History length, T in hops. Fixed, so the histories never need resizing.
     int num_beat_samples;
 
     // Index of next dft value in ring buffer.
@@ -39,7 +59,7 @@ struct Analysis_ {
 
     struct BeatAnalysis {
         int hz;
-        int dft_index;
+        int cqt_index;
 
         float noise_threshold_factor;
         float beat_threshold_factor;
@@ -48,7 +68,7 @@ struct Analysis_ {
 
         // Slowly moving average.
         float long_moving_average;
-        // Sum of last `num_beat_samples` `dft_values`.
+        // Sum of last `num_beat_samples` `dft_values`, recomputed every lap to stop float drift.
         float short_sum;
         // Sum of squares of last `num_beat_samples` `dft_values`.
         float short_square_sum;
@@ -60,29 +80,92 @@ struct Analysis_ {
 
     /* GPU DATA */
 
-    // Using struct here to align memory.
-    struct GpuData {
-        int is_beat;
-        int beats;
-        int bpm;
-        int other;
-
-        struct BandData {
-            float accumulated;
-            float window;
-            float smooth_window;
-            // second derivative
-            float delta2;
-            float movement;
-            float other1, other2, other3;
-        } bands[7];
-    } data;
+    struct GpuData* data;
 
     int gpu_buffer_size;
+    unsigned int buffer_index;
     Buffer buffer;
 };
 
-__attribute__((const)) int index_of_frequency(int frequency, int sample_rate, int dft_size) {
+// The band count is only known at startup, so the block can't live in the shader files.
+// Keep in sync with `struct GpuData`, arguments are the band count and the binding.
+static char const glsl_template[] =
+    "#define NUM_BANDS %d\n"
+    "\n"
+    "// Shape of the mid spectrum, the frequencies are in Hz.\n"
+    "struct SpectralFeatures {\n"
+    "    // Summed increase of the magnitudes since the previous frame.\n"
+    "    float flux;\n"
+    "    // `centroid` is a reserved word in GLSL.\n"
+    "    float centroid_hz;\n"
+    "    float spread;\n"
+    "    // 85%% of the magnitudes lie below.\n"
+    "    float rolloff;\n"
+    "    // 1 for white noise, near 0 for tones.\n"
+    "    float flatness;\n"
+    "    // Peak over mean.\n"
+    "    float crest;\n"
+    "    float other1, other2;\n"
+    "};\n"
+    "\n"
+    "// Tempo of the music, `bpm` in the block is this rounded.\n"
+    "struct TempoEstimate {\n"
+    "    float bpm;\n"
+    "    // 0 on the beat, rising towards 1.\n"
+    "    float phase;\n"
+    "    // 0 to 1, how periodic the onsets are.\n"
+    "    float confidence;\n"
+    "    float other;\n"
+    "};\n"
+    "\n"
+    "layout(std430, binding = %u) buffer analysis_data {\n"
+    "    bool is_beat;\n"
+    "    int beats;\n"
+    "    int bpm;\n"
+    "    int other;\n"
+    "\n"
+    "    SpectralFeatures features;\n"
+    "    TempoEstimate tempo;\n"
+    "\n"
+    "    int num_bands;\n"
+    "    int bands_other1, bands_other2, bands_other3;\n"
+    "    // Band `i` spans `band_edges_hz[i]` to `band_edges_hz[i + 1]`.\n"
+    "    float band_edges_hz[NUM_BANDS + 1];\n"
+    "    float band_accumulated[NUM_BANDS];\n"
+    "    float band_window[NUM_BANDS];\n"
+    "    float band_smooth_window[NUM_BANDS];\n"
+    "    float band_delta2[NUM_BANDS];\n"
+    "    float band_movement[NUM_BANDS];\n"
+    "};\n"
+    "\n"
+    "struct BandData {\n"
+    "    float accumulated;\n"
+    "    float window;\n"
+    "    float smooth_window;\n"
+    "    float delta2;\n"
+    "    float movement;\n"
+    "};\n"
+    "\n"
+    "// Band `i`, clamped to the ones there are.\n"
+    "BandData band_at(int i) {\n"
+    "    i = clamp(i, 0, NUM_BANDS - 1);\n"
+    "    return BandData(band_accumulated[i], band_window[i], band_smooth_window[i], band_delta2[i],\n"
+    "                    band_movement[i]);\n"
+    "}\n"
+    "\n"
+    "// Index of the band `hz` falls into, the outer ones extend to 0 Hz and beyond.\n"
+    "int band_of_hz(float hz) {\n"
+    "    int i = 0;\n"
+    "    while(i < NUM_BANDS - 1 && hz >= band_edges_hz[i + 1]) {\n"
+    "        i++;\n"
+    "    }\n"
+    "    return i;\n"
+    "}\n"
+    "\n"
+    "// Works with any band layout, e.g. `band_near(100.0)` for the bass.\n"
+    "BandData band_near(float hz) { return band_at(band_of_hz(hz)); }\n";
+
+__attribute__((const)) int index_of_frequency(float frequency, int sample_rate, int dft_size) {
     // For reference see
     // https://stackoverflow.com/questions/4364823/how-do-i-obtain-the-frequencies-of-each-value-in-an-fft
     // 0:   0 * 44100 / 1024 =     0.0 Hz
@@ -90,28 +173,43 @@ __attribute__((const)) int index_of_frequency(int frequency, int sample_rate, in
     // 2:   2 * 44100 / 1024 =    86.1 Hz
     // 3:   3 * 44100 / 1024 =   129.2 Hz
 
-    return (int)(roundf((float)frequency * (float)dft_size / (float)sample_rate));
+    return (int)(roundf(frequency * (float)dft_size / (float)sample_rate));
+}
+
+__attribute__((const)) int band_values_offset(int num_bands, enum BandValue value) {
+    // Only the edges have one more.
+    return value == BAND_EDGES_HZ ? 0 : num_bands + 1 + ((int)value - 1) * num_bands;
+}
+
+__attribute__((pure)) float const* band_values_of_gpu_data(struct GpuData const* data, enum BandValue value) {
+    return data->bands + band_values_offset(data->num_bands, value);
 }
 
-void set_band_border_indices(Analysis analysis) {
+__attribute__((pure)) float* band_values(Analysis analysis, enum BandValue value) {
+    return analysis->data->bands + band_values_offset(analysis->num_bands, value);
+}
+
+void set_band_border_indices(Analysis analysis, struct BandLayout const* band_layout) {
+    analysis->num_bands = band_layout->num_bands;
     int max_index = analysis->dft_size / 2 + 1;
-    FORI(0, 8) {
-        int fi = index_of_frequency(frequencies[i], analysis->sample_rate, analysis->dft_size);
-        analysis->frequency_indices[i] = CLAMP(fi, 1, max_index);
+    FORI(0, band_layout->num_bands + 1) {
+        int fi = index_of_frequency(band_layout->edges_hz[i], analysis->sample_rate, analysis->dft_size);
+        analysis->band_bins[i] = CLAMP(fi, 1, max_index);
     }
 }
 
 void initialize_beat_frequency(Analysis analysis, int beat_fequency_index) {
     struct BeatAnalysis* beat_analysis = analysis->beat_analysis + beat_fequency_index;
 
-    beat_analysis->dft_index = index_of_frequency(beat_analysis->hz, analysis->sample_rate, analysis->dft_size);
+    beat_analysis->cqt_index = cqt_bin_of_frequency(analysis->cqt, (float)beat_analysis->hz);
     beat_analysis->noise_threshold_factor = 0.25f;
     beat_analysis->beat_threshold_factor = 3.5f;
 
     beat_analysis->dft_values = ALLOCATE(analysis->num_beat_samples, float);
     FORI(0, analysis->num_beat_samples) { beat_analysis->dft_values[i] = 0.f; }
 
-    beat_analysis->long_moving_average = 1.f;
+    // Starts below everything, the noise gate opens right away as before.
+    beat_analysis->long_moving_average = 0.f;
     beat_analysis->short_sum = 0.f;
     beat_analysis->short_square_sum = 0.f;
     beat_analysis->sd = 0.f;
@@ -119,15 +217,14 @@ void initialize_beat_frequency(Analysis analysis, int beat_fequency_index) {
     beat_analysis->is_beat = false;
 }
 
-void initialize_beat_detection(Analysis analysis) {
+void initialize_beat_detection(Analysis analysis, int hop_size) {
     // Common data.
     analysis->num_beat_frequencies = 3;
-    analysis->last_time = clock();
-    // Initialize to something... e.g. 16ms @60FPS = 1s.
-    analysis->moving_average_process_time_ms = 16;
+    analysis->last_sample_index = 0;
     // 8 seconds.
-    analysis->short_average_window_ms = 8000;
-    analysis->num_beat_samples = (int)(analysis->short_average_window_ms / analysis->moving_average_process_time_ms);
+    analysis->short_average_window_s = 8.0f;
+    float hops_per_s = (float)analysis->sample_rate / (float)hop_size;
+    analysis->num_beat_samples = MAX(1, (int)roundf(analysis->short_average_window_s * hops_per_s));
     analysis->sample_index = 0;
 
     analysis->beat_analysis = ALLOCATE(analysis->num_beat_frequencies, struct BeatAnalysis);
@@ -141,127 +238,117 @@ void initialize_beat_detection(Analysis analysis) {
     FORI(0, analysis->num_beat_frequencies) { initialize_beat_frequency(analysis, i); }
 }
 
-void reinitialize_beat_frequency(Analysis analysis, int beat_fequency_index, int new_num_samples) {
-    struct BeatAnalysis* beat = analysis->beat_analysis + beat_fequency_index;
-
-    float* dft_values = ALLOCATE(new_num_samples, float);
-
-    // I'm going to recompute the short sums.
-    // SD is a computed value and the long average will adjust in time.
-    // These two don't need to be proactively recomputed.
-    beat->short_sum = 0.f;
-    beat->short_square_sum = 0.f;
-
-    // TODO THIS IS WRONG< WE NEED TO COPY THE VALUES IN REVERSE.
-    // IT DOESN"T MAKE A HUGE DIFFERENCE< BUT THIS IS WRONG ANYWAY.
-
-    // Copy all fitting dft values to the new buffer and recompute_sums.
-    int num_values_to_copy = MIN(analysis->num_beat_samples, new_num_samples);
-    FORI(0, num_values_to_copy) {
-        float old_value = beat->dft_values[(analysis->sample_index + i) % analysis->num_beat_samples];
-        dft_values[i] = old_value;
-        beat->short_sum += old_value;
-        beat->short_square_sum += old_value * old_value;
-    }
-
-    // Fill potential extension with average built from copied portion of values.
-    float avg = beat->short_sum / (float)num_values_to_copy;
-    FORI(num_values_to_copy, new_num_samples) {
-        dft_values[i] = avg;
-        beat->short_sum += avg;
-        beat->short_square_sum += avg * avg;
-    }
-
-    free(beat->dft_values);
-    beat->dft_values = dft_values;
-}
-
-void reinitialize_beat_analysis(Analysis analysis, int new_num_samples) {
-    FORI(0, analysis->num_beat_frequencies) { reinitialize_beat_frequency(analysis, i, new_num_samples); }
-
-    analysis->num_beat_samples = new_num_samples;
-    analysis->sample_index = 0; // Index unwrolled to 0.
-}
-
-Analysis create_analysis(Pcm pcm, DftData dft_data, unsigned int index) {
+Analysis create_analysis(DftData dft_data, Cqt cqt, Filterbank filterbank, BeatEvents beat_events,
+                         struct BandLayout const* band_layout, unsigned int index) {
     Analysis analysis = ALLOCATE(1, struct Analysis_);
 
     // Core data.
-    analysis->sample_rate = sample_rate_of_pcm(pcm);
+    analysis->sample_rate = sample_rate_of_dft(dft_data);
     analysis->dft_size = size_of_dft(dft_data);
+    analysis->cqt = cqt;
+    analysis->filterbank = filterbank;
+    analysis->beat_events = beat_events;
 
     // Band borders.
-    set_band_border_indices(analysis);
+    set_band_border_indices(analysis, band_layout);
+    // The bands trail the fixed part, one float each plus an edge.
+    int num_band_values = band_values_offset(analysis->num_bands, BAND_MOVEMENT) + analysis->num_bands;
+    analysis->gpu_buffer_size = isizeof(struct GpuData) + num_band_values * isizeof(float);
+    analysis->data = (struct GpuData*)malloc((size_t)analysis->gpu_buffer_size);
+    analysis->data->num_bands = analysis->num_bands;
+    analysis->data->other1 = 0;
+    analysis->data->other2 = 0;
+    analysis->data->other3 = 0;
+    memset(analysis->data->bands, 0, (size_t)num_band_values * sizeof(float));
+    memcpy(band_values(analysis, BAND_EDGES_HZ), band_layout->edges_hz,
+           (size_t)(analysis->num_bands + 1) * sizeof(float));
 
     // Beat detection.
-    initialize_beat_detection(analysis);
+    initialize_beat_detection(analysis, hop_size_of_dft(dft_data));
 
     // CPU side buffer data.
-    analysis->data.is_beat = false;
-    analysis->data.beats = 0;
-    analysis->data.bpm = 0;
-    analysis->data.other = 0;
-
-    FORI(0, 7) {
-        analysis->data.bands[i].accumulated = 0.0f;
-        analysis->data.bands[i].window = 0.0f;
-        analysis->data.bands[i].smooth_window = 0.0f;
-        analysis->data.bands[i].delta2 = 0.0f;
-        analysis->data.bands[i].movement = 0.0f;
-    }
+    analysis->data->is_beat = false;
+    analysis->data->beats = 0;
+    analysis->data->bpm = 0;
+    analysis->data->other = 0;
+
+    int num_bins = analysis->dft_size / 2 + 1;
+    analysis->previous_magnitudes = ALLOCATE(num_bins, float);
+    memset(analysis->previous_magnitudes, 0, (size_t)num_bins * sizeof(float));
+    memset(&analysis->data->features, 0, sizeof(analysis->data->features));
+    analysis->tempo = create_tempo(analysis->sample_rate, hop_size_of_dft(dft_data));
+    memset(&analysis->data->tempo, 0, sizeof(analysis->data->tempo));
 
     // GPU buffer.
-    analysis->gpu_buffer_size = isizeof(analysis->data);
-    analysis->buffer = create_storage_buffer(analysis->gpu_buffer_size, index);
+    analysis->buffer_index = index;
+    analysis->buffer = create_streaming_storage_buffer(analysis->gpu_buffer_size, index);
 
     return analysis;
 }
 
-void analyze_band(DftData dft_data, Analysis analysis, int band_index) {
-    struct BandData* band = analysis->data.bands + band_index;
-
-    float window = 0.0f;
-    FORI(analysis->frequency_indices[band_index], analysis->frequency_indices[band_index + 1]) {
-        window += dft_at(dft_data, i);
+void analyze_bands(DftData dft_data, Analysis analysis) {
+    float const* magnitudes = magnitudes_of_dft(dft_data);
+    float* accumulated = band_values(analysis, BAND_ACCUMULATED);
+    float* windows = band_values(analysis, BAND_WINDOW);
+    float* smooth_windows = band_values(analysis, BAND_SMOOTH_WINDOW);
+    float* delta2s = band_values(analysis, BAND_DELTA2);
+    float* movements = band_values(analysis, BAND_MOVEMENT);
+
+    for(int band = 0; band < analysis->num_bands; band++) {
+        float window = 0.0f;
+        FORI(analysis->band_bins[band], analysis->band_bins[band + 1]) {
+            window += magnitudes[i];
+        }
+
+        float delta2 = fabsf(windows[band] - window);
+        // Smoothing?
+        /* float avg_delta2 = mix(analysis->bands[band].avg_delta2, cur_delta2, 0.2f); */
+
+        windows[band] = window;
+        smooth_windows[band] = mix(smooth_windows[band], window, 0.02f);
+        accumulated[band] += window;
+
+        delta2s[band] = delta2;
+        movements[band] += delta2;
     }
-    /* if (band == 1) { */
-    /*     printf("\n"); */
-    /* } */
-
-    float delta2 = fabsf(band->window - window);
-    // Smoothing?
-    /* float avg_delta2 = mix(analysis->bands[band].avg_delta2, cur_delta2, 0.2f); */
-
-    /* if (band == 1) { */
-    /* printf("wind: %.2f \t last wind: %.2f \t avg delta: %.2f \t cur_delta: %.2f \n", (double)windowed,
-     * (double)analysis->bands[band].windowed, (double)analysis->bands[band].avg_delta2, (double)cur_delta2); */
-    /* } */
-
-    band->window = window;
-    band->smooth_window = mix(band->smooth_window, window, 0.02f);
-    band->accumulated += window;
+}
 
-    band->delta2 = delta2;
-    band->movement += delta2;
+void analyze_features(DftData dft_data, Analysis analysis) {
+    int num_bins = analysis->dft_size / 2 + 1;
+    float bin_hz = (float)analysis->sample_rate / (float)analysis->dft_size;
+    float const* magnitudes = magnitudes_of_dft(dft_data);
+    compute_spectral_features(magnitudes, analysis->previous_magnitudes, num_bins, bin_hz, &analysis->data->features);
+    memcpy(analysis->previous_magnitudes, magnitudes, (size_t)num_bins * sizeof(float));
 }
 
-void analyze_bands(DftData dft_data, Analysis analysis) {
-    FORI(0, 7) {
-        analyze_band(dft_data, analysis, i);
+void analyze_tempo(DftData dft_data, Analysis analysis) {
+    float previous_phase = analysis->data->tempo.phase;
+    add_tempo_onset(analysis->tempo, analysis->data->features.flux, &analysis->data->tempo);
+    analysis->data->bpm = (int)roundf(analysis->data->tempo.bpm);
+
+    // The phase wrapped during this hop, the beat was `phase` beats ago.
+    struct TempoEstimate const* tempo = &analysis->data->tempo;
+    if(tempo->bpm > 0.0f && tempo->phase < previous_phase - 0.5f) {
+        float samples_per_beat = 60.0f * (float)analysis->sample_rate / tempo->bpm;
+        struct BeatEvent event = {
+            .sample_index = sample_index_of_dft(dft_data) - (uint64_t)(tempo->phase * samples_per_beat),
+            .band = BEAT_EVENT_TEMPO,
+            .strength = tempo->confidence,
+        };
+        push_beat_event(analysis->beat_events, event);
     }
 }
 
-void analyze_beat(DftData dft_data, Analysis analysis, int beat_fequency_index) {
+void analyze_beat(Analysis analysis, int beat_fequency_index) {
     struct BeatAnalysis* beat = analysis->beat_analysis + beat_fequency_index;
 
-    // Adjust average TODO recompute entirely every X frames (it's not an int, it's a float!)?
     // Subtract value i'm going to replace.
     float prev_value = beat->dft_values[analysis->sample_index];
     beat->short_sum -= prev_value;
     beat->short_square_sum -= prev_value * prev_value;
 
     // Add the current value.
-    float current_value = dft_at(dft_data, beat->dft_index);
+    float current_value = magnitudes_of_cqt(analysis->cqt)[beat->cqt_index];
 
     beat->dft_values[analysis->sample_index] = current_value;
 
@@ -281,74 +368,127 @@ void analyze_beat(DftData dft_data, Analysis analysis, int beat_fequency_index)
     beat->is_beat = is_not_noise && is_over_sd; // && is_local_beat;
 }
 
-void print_beat_analysis_debug(DftData dft_data, Analysis analysis) {
-    printf("%d", analysis->data.beats);
+void print_beat_analysis_debug(Analysis analysis) {
+    printf("%d", analysis->data->beats);
     FORI(0, analysis->num_beat_frequencies) {
         struct BeatAnalysis* beat = analysis->beat_analysis + i;
         float avg = beat->short_sum / (float)analysis->num_beat_samples;
         /* hz idx noize avg thresh cur sd is_beat */
-        printf(",%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%d", beat->hz, beat->dft_index,
+        printf(",%d,%d,%.2f,%.2f,%.2f,%.2f,%.2f,%d", beat->hz, beat->cqt_index,
                (double)(beat->noise_threshold_factor * beat->long_moving_average), (double)avg,
-               (double)(beat->beat_threshold_factor * avg), (double)dft_at(dft_data, beat->dft_index),
+               (double)(beat->beat_threshold_factor * avg), (double)magnitudes_of_cqt(analysis->cqt)[beat->cqt_index],
                (double)(avg + 2.4f * beat->sd), beat->is_beat);
     }
     printf("\n");
 }
 
+void recompute_beat_sums(Analysis analysis) {
+    FORI(0, analysis->num_beat_frequencies) {
+        struct BeatAnalysis* beat = analysis->beat_analysis + i;
+        beat->short_sum = 0.f;
+        beat->short_square_sum = 0.f;
+        for(int j = 0; j < analysis->num_beat_samples; j++) {
+            beat->short_sum += beat->dft_values[j];
+            beat->short_square_sum += beat->dft_values[j] * beat->dft_values[j];
+        }
+    }
+}
+
 void analyze_beats(DftData dft_data, Analysis analysis) {
-    // Check and adjust timing.
-    time_t this_time = clock();
-    float const s_to_ms = 1000.0f;
-    float delta_ms = s_to_ms * (float)(this_time - analysis->last_time) / CLOCKS_PER_SEC;
-    analysis->last_time = this_time;
-
-    // Adjust the moving average cycle time: delta.
-    float old_avg_process_time = analysis->moving_average_process_time_ms;
-    analysis->moving_average_process_time_ms = mix(old_avg_process_time, delta_ms, 0.01f);
-
-    // Check that the timing is still right.
-    int old_num_samples = analysis->num_beat_samples;
-    int new_num_samples = (int)(analysis->short_average_window_ms / analysis->moving_average_process_time_ms);
-
-    float difference_percent = fabsf((float)(new_num_samples - old_num_samples)) / (float)(old_num_samples);
-    if(difference_percent > 0.15f) {
-        printf("Too much beat buffer size difference:\n");
-        printf("\tPrev delta %.2f\tCurrent delta %.2f\tNew delta %.2f\n", (double)old_avg_process_time,
-               (double)delta_ms, (double)analysis->moving_average_process_time_ms);
-        printf("\tPrev #samples %d\tNew #samples %d\n", old_num_samples, new_num_samples);
-
-        reinitialize_beat_analysis(analysis, new_num_samples);
+    uint64_t this_sample_index = sample_index_of_dft(dft_data);
+    if(this_sample_index == analysis->last_sample_index) {
+        // No new audio, the spectrum hasn't changed.
+        return;
     }
+    analysis->last_sample_index = this_sample_index;
 
     // Merge per-frequency results.
     bool is_beat = false;
 
     FORI(0, analysis->num_beat_frequencies) {
-        analyze_beat(dft_data, analysis, i);
-        is_beat |= analysis->beat_analysis[i].is_beat;
+        struct BeatAnalysis* beat = analysis->beat_analysis + i;
+        bool was_beat = beat->is_beat;
+        analyze_beat(analysis, i);
+        is_beat |= beat->is_beat;
+
+        if(beat->is_beat && !was_beat) {
+            float short_average = beat->short_sum / (float)analysis->num_beat_samples;
+            float threshold = short_average + 2.4f * beat->sd;
+            float current = magnitudes_of_cqt(analysis->cqt)[beat->cqt_index];
+            struct BeatEvent event = {
+                .sample_index = this_sample_index,
+                .band = i,
+                .strength = threshold > 0.0f ? current / threshold : 1.0f,
+            };
+            push_beat_event(analysis->beat_events, event);
+        }
     }
 
     // Move the index along the ringbuffer.
     analysis->sample_index = (analysis->sample_index + 1) % analysis->num_beat_samples;
+    if(analysis->sample_index == 0) {
+        recompute_beat_sums(analysis);
+    }
 
     if(is_beat) {
-        analysis->data.beats += analysis->data.is_beat ? 0 : 1;
+        analysis->data->beats += analysis->data->is_beat ? 0 : 1;
     }
 
     /* print_beat_analysis_debug(analysis); */
 
-    analysis->data.is_beat = is_beat;
+    analysis->data->is_beat = is_beat;
+}
+
+__attribute__((pure)) struct GpuData const* gpu_data_of_analysis(Analysis analysis) { return analysis->data; }
+
+char* glsl_of_analysis(Analysis analysis) {
+    int size = snprintf(NULL, 0, glsl_template, analysis->num_bands, analysis->buffer_index) + 1;
+    char* glsl = ALLOCATE(size, char);
+    snprintf(glsl, (size_t)size, glsl_template, analysis->num_bands, analysis->buffer_index);
+    return glsl;
 }
 
-void compute_and_copy_analysis_to_gpu(DftData dft_data, Analysis analysis) {
+__attribute__((pure)) int gpu_data_size_of_analysis(Analysis analysis) { return analysis->gpu_buffer_size; }
+
+__attribute__((pure)) int num_beat_frequencies_of_analysis(Analysis analysis) { return analysis->num_beat_frequencies; }
+
+__attribute__((pure)) struct BeatState beat_state_of_analysis(Analysis analysis, int beat_frequency_index) {
+    struct BeatAnalysis* beat = analysis->beat_analysis + beat_frequency_index;
+    float avg = beat->short_sum / (float)analysis->num_beat_samples;
+    return (struct BeatState){
+        .hz = beat->hz,
+        .cqt_index = beat->cqt_index,
+        .noise_threshold = beat->noise_threshold_factor * beat->long_moving_average,
+        .short_average = avg,
+        .beat_threshold = beat->beat_threshold_factor * avg,
+        .current = magnitudes_of_cqt(analysis->cqt)[beat->cqt_index],
+        .sd_threshold = avg + 2.4f * beat->sd,
+        .is_beat = beat->is_beat,
+    };
+}
+
+void analyze_dft_frame(Pcm pcm, DftData dft_data, Analysis analysis) {
+    compute_cqt(pcm, dft_data, analysis->cqt);
+    compute_filterbank(dft_data, analysis->filterbank);
     analyze_bands(dft_data, analysis);
+    analyze_features(dft_data, analysis);
+    analyze_tempo(dft_data, analysis);
     analyze_beats(dft_data, analysis);
-    copy_buffer_to_gpu(analysis->buffer, (char*)&analysis->data, 0, analysis->gpu_buffer_size);
+}
+
+void copy_analysis_to_gpu(Analysis analysis) { copy_analysis_data_to_gpu(analysis, analysis->data); }
+
+void copy_analysis_data_to_gpu(Analysis analysis, struct GpuData const* data) {
+    copy_buffer_to_gpu(analysis->buffer, data, 0, analysis->gpu_buffer_size);
+    commit_buffer_to_gpu(analysis->buffer);
 }
 
 void delete_analysis(Analysis analysis) {
     FORI(0, analysis->num_beat_frequencies) { free(analysis->beat_analysis[i].dft_values); }
     free(analysis->beat_analysis);
+    free(analysis->previous_magnitudes);
+    delete_tempo(analysis->tempo);
     delete_buffer(analysis->buffer);
+    free(analysis->data);
     free(analysis);
 }
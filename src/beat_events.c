@@ -0,0 +1,107 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "beat_events.h"
+#include "buffers.h"
+#include "globals.h"
+
+// Layout of an element of `beat_events[]`, sample indices are 31 bits like in `pcm_data`.
+struct GpuBeatEvent {
+    int sample_index;
+    int band;
+    float strength;
+    float other;
+};
+
+struct BeatEvents_ {
+    int capacity;
+    struct BeatEvent* events;
+    // Events ever pushed and popped, an event goes to `count % capacity`. The
+    // producer publishes with a release store of `num_pushed`, the consumer
+    // frees slots with a release store of `num_popped`.
+    _Atomic uint64_t num_pushed;
+    _Atomic uint64_t num_popped;
+
+    // Layout of the `beat_event_data` block, the events follow.
+    struct {
+        int sample_index;
+        int num_events;
+        int other1, other2;
+    } header;
+    struct GpuBeatEvent* gpu_events;
+    Buffer buffer;
+};
+
+BeatEvents create_beat_events(int capacity, unsigned int index) {
+    BeatEvents beat_events = ALLOCATE(1, struct BeatEvents_);
+    beat_events->capacity = capacity;
+    beat_events->events = ALLOCATE(capacity, struct BeatEvent);
+    atomic_init(&beat_events->num_pushed, 0);
+    atomic_init(&beat_events->num_popped, 0);
+
+    beat_events->header.sample_index = 0;
+    beat_events->header.num_events = 0;
+    beat_events->header.other1 = 0;
+    beat_events->header.other2 = 0;
+    beat_events->gpu_events = ALLOCATE(capacity, struct GpuBeatEvent);
+    int size = isizeof(beat_events->header) + capacity * isizeof(struct GpuBeatEvent);
+    beat_events->buffer = create_streaming_storage_buffer(size, index);
+    copy_buffer_to_gpu(beat_events->buffer, &beat_events->header, 0, isizeof(beat_events->header));
+    commit_buffer_to_gpu(beat_events->buffer);
+
+    return beat_events;
+}
+
+bool push_beat_event(BeatEvents beat_events, struct BeatEvent event) {
+    uint64_t num_pushed = atomic_load_explicit(&beat_events->num_pushed, memory_order_relaxed);
+    uint64_t num_popped = atomic_load_explicit(&beat_events->num_popped, memory_order_acquire);
+    if(num_pushed - num_popped >= (uint64_t)beat_events->capacity) {
+        return false;
+    }
+    beat_events->events[num_pushed % (uint64_t)beat_events->capacity] = event;
+    atomic_store_explicit(&beat_events->num_pushed, num_pushed + 1, memory_order_release);
+    return true;
+}
+
+bool pop_beat_event(BeatEvents beat_events, struct BeatEvent* event) {
+    uint64_t num_popped = atomic_load_explicit(&beat_events->num_popped, memory_order_relaxed);
+    uint64_t num_pushed = atomic_load_explicit(&beat_events->num_pushed, memory_order_acquire);
+    if(num_popped == num_pushed) {
+        return false;
+    }
+    *event = beat_events->events[num_popped % (uint64_t)beat_events->capacity];
+    atomic_store_explicit(&beat_events->num_popped, num_popped + 1, memory_order_release);
+    return true;
+}
+
+void copy_beat_events_to_gpu(BeatEvents beat_events, uint64_t sample_index) {
+    int num_events = 0;
+    struct BeatEvent event;
+    while(num_events < beat_events->capacity && pop_beat_event(beat_events, &event)) {
+        beat_events->gpu_events[num_events] = (struct GpuBeatEvent){
+            .sample_index = (int)(event.sample_index & INT32_MAX),
+            .band = event.band,
+            .strength = event.strength,
+            .other = 0.0f,
+        };
+        num_events++;
+    }
+
+    // The header goes up every frame, so that no event is shown twice.
+    beat_events->header.sample_index = (int)(sample_index & INT32_MAX);
+    beat_events->header.num_events = num_events;
+    copy_buffer_to_gpu(beat_events->buffer, &beat_events->header, 0, 2 * isizeof(int));
+    if(num_events > 0) {
+        copy_buffer_to_gpu(beat_events->buffer, beat_events->gpu_events, isizeof(beat_events->header),
+                           num_events * isizeof(struct GpuBeatEvent));
+    }
+    commit_buffer_to_gpu(beat_events->buffer);
+}
+
+void delete_beat_events(BeatEvents beat_events) {
+    delete_buffer(beat_events->buffer);
+    free(beat_events->gpu_events);
+    free(beat_events->events);
+    free(beat_events);
+}
@@ -1,16 +1,62 @@
 #define GL_GLEXT_PROTOTYPES
 
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <SDL2/SDL_opengl.h>
 
 #include "buffers.h"
+#include "globals.h"
+
+// A streaming buffer's regions, the GPU can still be reading all but the one being written.
+#define STREAMING_REGIONS 3
+// Separate changed ranges a region remembers, more get merged with their closest one.
+#define STALE_RANGES 8
+
+struct Range {
+    int begin;
+    int end;
+};
+
+struct Region {
+    // Signals once the GPU is done with the frames that read this region.
+    GLsync fence;
+    // Bytes changed since this region was last written.
+    struct Range stale[STALE_RANGES];
+    int num_stale;
+};
+
+struct Buffer_ {
+    GLenum target;
+    GLuint buffer;
+    GLuint index;
+    int size;
+
+    // Streaming buffers only, `shadow` is NULL for the others.
+    char* shadow;
+    char* mapping;
+    int stride;
+    int region;
+    bool dirty;
+    struct Region regions[STREAMING_REGIONS];
+};
 
 Buffer create_buffer(GLenum target, int size, unsigned int index) {
-    Buffer buffer;
-    buffer.target = target;
-    glGenBuffers(1, &buffer.buffer);
-    glBindBuffer(target, buffer.buffer);
+    Buffer buffer = ALLOCATE(1, struct Buffer_);
+    buffer->target = target;
+    buffer->index = index;
+    buffer->size = size;
+    buffer->shadow = NULL;
+    buffer->mapping = NULL;
+
+    glGenBuffers(1, &buffer->buffer);
+    glBindBuffer(target, buffer->buffer);
     glBufferData(target, size, NULL, GL_DYNAMIC_DRAW);
-    glBindBufferBase(target, index, buffer.buffer);
+    glBindBufferBase(target, index, buffer->buffer);
     glBindBuffer(target, 0);
     return buffer;
 }
@@ -23,18 +69,191 @@ Buffer create_storage_buffer(int size, unsigned int index) {
     return create_buffer(GL_SHADER_STORAGE_BUFFER, size, index);
 }
 
-void copy_buffer_to_gpu(Buffer buffer, void* data, int buffer_offset, int size) {
-    glBindBuffer(buffer.target, buffer.buffer);
-    glBufferSubData(buffer.target, buffer_offset, size, data);
-    glBindBuffer(buffer.target, 0);
+bool has_buffer_storage(void) {
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if(major > 4 || (major == 4 && minor >= 4)) {
+        return true;
+    }
+
+    GLint num_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+    FORI(0, num_extensions) {
+        char const* extension = (char const*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if(extension != NULL && strcmp(extension, "GL_ARB_buffer_storage") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void bind_region(Buffer buffer) {
+    glBindBufferRange(buffer->target, buffer->index, buffer->buffer, (GLintptr)buffer->region * buffer->stride,
+                      buffer->size);
 }
 
-void copy_ringbuffer_to_gpu(Buffer buffer, void* data, int buffer_offset, int size, int wrap_offset) {
-    int tail_size = size - wrap_offset;
-    copy_buffer_to_gpu(buffer, ((char*)data) + wrap_offset, buffer_offset, tail_size);
-    copy_buffer_to_gpu(buffer, data, buffer_offset + tail_size, wrap_offset);
+Buffer create_streaming_buffer(GLenum target, GLenum alignment_name, int size, unsigned int index) {
+    if(!has_buffer_storage()) {
+        return create_buffer(target, size, index);
+    }
+
+    Buffer buffer = ALLOCATE(1, struct Buffer_);
+    buffer->target = target;
+    buffer->index = index;
+    buffer->size = size;
+
+    // Bound ranges have to start at a multiple of the alignment.
+    GLint alignment = 1;
+    glGetIntegerv(alignment_name, &alignment);
+    alignment = MAX(alignment, 1);
+    buffer->stride = (size + alignment - 1) / alignment * alignment;
+    GLsizeiptr storage_size = (GLsizeiptr)buffer->stride * STREAMING_REGIONS;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &buffer->buffer);
+    glBindBuffer(target, buffer->buffer);
+    glBufferStorage(target, storage_size, NULL, flags);
+    buffer->mapping = (char*)glMapBufferRange(target, 0, storage_size, flags);
+    glBindBuffer(target, 0);
+    if(buffer->mapping == NULL) {
+        fprintf(stderr, "Failed to map a streaming buffer of %d bytes\n", size);
+        exit(1);
+    }
+
+    buffer->shadow = ALLOCATE(size, char);
+    memset(buffer->shadow, 0, (size_t)size);
+    memset(buffer->mapping, 0, (size_t)storage_size);
+    buffer->region = 0;
+    buffer->dirty = false;
+    FORI(0, STREAMING_REGIONS) {
+        buffer->regions[i].fence = NULL;
+        buffer->regions[i].num_stale = 0;
+    }
+    bind_region(buffer);
+    return buffer;
+}
+
+Buffer create_streaming_uniform_buffer(int size, unsigned int index) {
+    return create_streaming_buffer(GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, size, index);
+}
+
+Buffer create_streaming_storage_buffer(int size, unsigned int index) {
+    return create_streaming_buffer(GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, size, index);
+}
+
+__attribute__((const)) int gap_between(struct Range range, int begin, int end) {
+    return range.begin > end ? range.begin - end : begin - range.end;
+}
+
+void add_stale_range(struct Region* region, int begin, int end) {
+    // Absorb the ranges that overlap or touch the new one.
+    int j = 0;
+    while(j < region->num_stale) {
+        if(gap_between(region->stale[j], begin, end) <= 0) {
+            begin = MIN(begin, region->stale[j].begin);
+            end = MAX(end, region->stale[j].end);
+            region->num_stale--;
+            region->stale[j] = region->stale[region->num_stale];
+        } else {
+            j++;
+        }
+    }
+
+    // Out of slots, merge with the closest range and copy the gap in between as well.
+    if(region->num_stale == STALE_RANGES) {
+        int closest = 0;
+        int closest_gap = INT_MAX;
+        FORI(0, region->num_stale) {
+            int gap = gap_between(region->stale[i], begin, end);
+            if(gap < closest_gap) {
+                closest = i;
+                closest_gap = gap;
+            }
+        }
+        begin = MIN(begin, region->stale[closest].begin);
+        end = MAX(end, region->stale[closest].end);
+        region->num_stale--;
+        region->stale[closest] = region->stale[region->num_stale];
+    }
+
+    region->stale[region->num_stale] = (struct Range){.begin = begin, .end = end};
+    region->num_stale++;
+}
+
+void copy_buffer_to_gpu(Buffer buffer, void const* data, int buffer_offset, int size) {
+    if(buffer->shadow == NULL) {
+        glBindBuffer(buffer->target, buffer->buffer);
+        glBufferSubData(buffer->target, buffer_offset, size, data);
+        glBindBuffer(buffer->target, 0);
+        return;
+    }
+
+    memcpy(buffer->shadow + buffer_offset, data, (size_t)size);
+    FORI(0, STREAMING_REGIONS) { add_stale_range(buffer->regions + i, buffer_offset, buffer_offset + size); }
+    buffer->dirty = true;
+}
+
+void wait_for_region(struct Region* region) {
+    if(region->fence == NULL) {
+        return;
+    }
+
+    // Only flush on the first try, the fence is on its way after that.
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    GLuint64 const timeout_ns = 1000000000;
+    while(true) {
+        GLenum status = glClientWaitSync(region->fence, flags, timeout_ns);
+        if(status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED) {
+            break;
+        }
+        if(status == GL_WAIT_FAILED) {
+            fprintf(stderr, "Failed to glClientWaitSync\n");
+            exit(1);
+        }
+        flags = 0;
+    }
+    glDeleteSync(region->fence);
+    region->fence = NULL;
+}
+
+void commit_buffer_to_gpu(Buffer buffer) {
+    if(buffer->shadow == NULL || !buffer->dirty) {
+        return;
+    }
+
+    // Everything that reads the current region is submitted by now.
+    buffer->regions[buffer->region].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer->region = (buffer->region + 1) % STREAMING_REGIONS;
+    struct Region* region = buffer->regions + buffer->region;
+    wait_for_region(region);
+
+    // Catch the region up on all changes since it was last written.
+    char* mapping = buffer->mapping + buffer->region * buffer->stride;
+    FORI(0, region->num_stale) {
+        struct Range range = region->stale[i];
+        memcpy(mapping + range.begin, buffer->shadow + range.begin, (size_t)(range.end - range.begin));
+    }
+    region->num_stale = 0;
+    buffer->dirty = false;
+
+    // The mapping is coherent, commands from here on see the writes.
+    bind_region(buffer);
 }
 
 void delete_buffer(Buffer buffer) {
-    glDeleteBuffers(1, &buffer.buffer);
+    if(buffer->shadow != NULL) {
+        FORI(0, STREAMING_REGIONS) {
+            if(buffer->regions[i].fence != NULL) {
+                glDeleteSync(buffer->regions[i].fence);
+            }
+        }
+        glBindBuffer(buffer->target, buffer->buffer);
+        glUnmapBuffer(buffer->target);
+        glBindBuffer(buffer->target, 0);
+        free(buffer->shadow);
+    }
+    glDeleteBuffers(1, &buffer->buffer);
+    free(buffer);
 }
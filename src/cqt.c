@@ -0,0 +1,238 @@
+// Constant-Q transform after Brown and Puckette, "An efficient algorithm for the
+// calculation of a constant Q transform". Every bin correlates the signal with a
+// Hann windowed complex exponential of its own length. By Parseval that equals a
+// dot product of the spectra, and the kernel spectra are so concentrated that a
+// few values per bin are enough. So per frame it's one FFT plus a sparse product.
+//
+// Constant Q needs windows that get longer towards the bass, which the 4096 point
+// DFT can't provide, so the CQT runs its own FFT of up to CQT_MAX_WINDOW_S. Below
+// the frequency where that would not be enough, the bandwidth stops shrinking
+// (variable Q, B = f / Q + gamma).
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fftw3.h>
+
+#include "buffers.h"
+#include "cqt.h"
+#include "globals.h"
+
+// Longest window, the FFT size is the largest power of two that fits.
+#define CQT_MAX_WINDOW_S 0.4f
+// Kernel values below this fraction of the peak of their bin are dropped.
+#define CQT_SPARSITY 0.005f
+
+struct Cqt_ {
+    int size;
+    int sample_rate;
+    int bins_per_octave;
+    float min_hz;
+    int num_bins;
+
+    // Sparse spectral kernel, bin k uses the FFT bins from `kernel_first[k]` on,
+    // its values are `[kernel_offsets[k], kernel_offsets[k + 1])`.
+    int* kernel_first;
+    int* kernel_offsets;
+    float* kernel_re;
+    float* kernel_im;
+
+    // Index of the sample after the last transformed window.
+    uint64_t sample_index;
+    float* right;
+    float* in;
+    float* out;
+    fftwf_plan plan;
+    // Unpacked `out`, bins 0 to `size / 2`.
+    float* spectrum_re;
+    float* spectrum_im;
+    float* magnitudes;
+
+    Buffer buffer;
+};
+
+// Adds the sparse spectral kernel of one bin, `scratch` holds `size` complex values.
+void add_cqt_kernel(Cqt cqt, int bin, int length, fftwf_complex* scratch, fftwf_plan plan, int* num_values) {
+    int const size = cqt->size;
+    float hz = frequency_of_cqt_bin(cqt, bin);
+
+    // Windows end with the frame, so that short ones see the newest samples.
+    memset(scratch, 0, (size_t)size * sizeof(fftwf_complex));
+    float window_sum = 0.0f;
+    FORI(0, length) { window_sum += 0.5f - 0.5f * cosf(2.0f * PI * (float)i / (float)length); }
+    FORI(0, length) {
+        int n = size - length + i;
+        float window = (0.5f - 0.5f * cosf(2.0f * PI * (float)i / (float)length)) / window_sum;
+        // Up to tens of thousands of radians, too much for float.
+        double const tau = 6.283185307179586;
+        double phase = tau * (double)hz * (double)n / (double)cqt->sample_rate;
+        scratch[n][0] = window * (float)cos(phase);
+        scratch[n][1] = window * (float)sin(phase);
+    }
+    fftwf_execute(plan);
+
+    // The kernel is analytic, only the positive half of the spectrum matters.
+    float peak = 0.0f;
+    FORI(0, size / 2 + 1) { peak = MAX(peak, hypotf(scratch[i][0], scratch[i][1])); }
+    int first = 0;
+    int last = size / 2;
+    while(hypotf(scratch[first][0], scratch[first][1]) < CQT_SPARSITY * peak) {
+        first++;
+    }
+    while(hypotf(scratch[last][0], scratch[last][1]) < CQT_SPARSITY * peak) {
+        last--;
+    }
+
+    int width = last - first + 1;
+    cqt->kernel_re = realloc(cqt->kernel_re, (size_t)(*num_values + width) * sizeof(float));
+    cqt->kernel_im = realloc(cqt->kernel_im, (size_t)(*num_values + width) * sizeof(float));
+    // The 1 / size of the inverse transform goes into the kernel.
+    FORI(0, width) {
+        cqt->kernel_re[*num_values + i] = scratch[first + i][0] / (float)size;
+        cqt->kernel_im[*num_values + i] = scratch[first + i][1] / (float)size;
+    }
+    cqt->kernel_first[bin] = first;
+    *num_values += width;
+    cqt->kernel_offsets[bin + 1] = *num_values;
+}
+
+Cqt create_cqt(DftData dft_data, int bins_per_octave, float min_hz, enum DftPlanning planning, unsigned int index) {
+    Cqt cqt = ALLOCATE(1, struct Cqt_);
+    int sample_rate = sample_rate_of_dft(dft_data);
+
+    int size = size_of_dft(dft_data);
+    while(2 * size <= (int)(CQT_MAX_WINDOW_S * (float)sample_rate)) {
+        size *= 2;
+    }
+    cqt->size = size;
+    cqt->sample_rate = sample_rate;
+    cqt->bins_per_octave = bins_per_octave;
+    cqt->min_hz = min_hz;
+
+    // Bandwidths B = f / Q + gamma, gamma makes the lowest bin fill the whole FFT.
+    float q = 1.0f / (powf(2.0f, 1.0f / (float)bins_per_octave) - 1.0f);
+    float gamma = MAX(0.0f, (float)sample_rate / (float)size - min_hz / q);
+    // The highest bin has to stay clear of Nyquist.
+    float max_hz = 0.5f * (float)sample_rate / (1.0f + 0.5f / q);
+    cqt->num_bins = (int)floorf((float)bins_per_octave * log2f(max_hz / min_hz)) + 1;
+    assert(cqt->num_bins > 0);
+
+    cqt->kernel_first = ALLOCATE(cqt->num_bins, int);
+    cqt->kernel_offsets = ALLOCATE(cqt->num_bins + 1, int);
+    cqt->kernel_offsets[0] = 0;
+    cqt->kernel_re = NULL;
+    cqt->kernel_im = NULL;
+
+    fftwf_complex* scratch = fftwf_malloc((size_t)size * sizeof(fftwf_complex));
+    fftwf_plan kernel_plan = fftwf_plan_dft_1d(size, scratch, scratch, FFTW_FORWARD, FFTW_ESTIMATE);
+    int num_values = 0;
+    FORI(0, cqt->num_bins) {
+        float bandwidth = frequency_of_cqt_bin(cqt, i) / q + gamma;
+        int length = MIN(size, (int)roundf((float)sample_rate / bandwidth));
+        add_cqt_kernel(cqt, i, length, scratch, kernel_plan, &num_values);
+    }
+    fftwf_destroy_plan(kernel_plan);
+    fftwf_free(scratch);
+
+    cqt->sample_index = 0;
+    cqt->right = ALLOCATE(size, float);
+    cqt->in = fftwf_malloc((size_t)size * sizeof(float));
+    cqt->out = fftwf_malloc((size_t)size * sizeof(float));
+    cqt->plan = fftwf_plan_r2r_1d(size, cqt->in, cqt->out, FFTW_R2HC, fftw_flags_of_planning(planning));
+    cqt->spectrum_re = ALLOCATE(size / 2 + 1, float);
+    cqt->spectrum_im = ALLOCATE(size / 2 + 1, float);
+    cqt->magnitudes = ALLOCATE(cqt->num_bins, float);
+    memset(cqt->magnitudes, 0, (size_t)cqt->num_bins * sizeof(float));
+
+    printf("Constant-Q: %d bins from %.1f to %.0f Hz, %d point FFT, %d kernel values\n", cqt->num_bins,
+           (double)min_hz, (double)frequency_of_cqt_bin(cqt, cqt->num_bins - 1), size, num_values);
+
+    // Header followed by the magnitudes, see `cqt_data` in the shaders.
+    int gpu_buffer_size = 3 * isizeof(int) + cqt->num_bins * isizeof(float);
+    cqt->buffer = create_streaming_storage_buffer(gpu_buffer_size, index);
+    copy_buffer_to_gpu(cqt->buffer, (char*)&cqt->num_bins, 0, sizeof(int));
+    copy_buffer_to_gpu(cqt->buffer, (char*)&cqt->bins_per_octave, sizeof(int), sizeof(int));
+    copy_buffer_to_gpu(cqt->buffer, (char*)&cqt->min_hz, 2 * sizeof(int), sizeof(float));
+    commit_buffer_to_gpu(cqt->buffer);
+
+    return cqt;
+}
+
+__attribute__((pure)) int num_bins_of_cqt(Cqt cqt) { return cqt->num_bins; }
+
+__attribute__((pure)) float frequency_of_cqt_bin(Cqt cqt, int bin) {
+    return cqt->min_hz * powf(2.0f, (float)bin / (float)cqt->bins_per_octave);
+}
+
+__attribute__((pure)) int cqt_bin_of_frequency(Cqt cqt, float hz) {
+    int bin = (int)roundf((float)cqt->bins_per_octave * log2f(hz / cqt->min_hz));
+    return CLAMP(bin, 0, cqt->num_bins - 1);
+}
+
+__attribute__((pure)) float const* magnitudes_of_cqt(Cqt cqt) { return cqt->magnitudes; }
+
+void compute_cqt(Pcm pcm, DftData dft_data, Cqt cqt) {
+    uint64_t sample_index = sample_index_of_dft(dft_data);
+    // Already done, or overwritten by the producer, keep the last result then.
+    if(sample_index == cqt->sample_index || !copy_pcm_window(pcm, sample_index, cqt->size, cqt->in, cqt->right)) {
+        return;
+    }
+    cqt->sample_index = sample_index;
+
+    int const size = cqt->size;
+    FORI(0, size) { cqt->in[i] = 0.5f * (cqt->in[i] + cqt->right[i]); }
+    fftwf_execute(cqt->plan);
+
+    // Unpack the halfcomplex output so the products run over contiguous memory.
+    cqt->spectrum_re[0] = cqt->out[0];
+    cqt->spectrum_im[0] = 0.0f;
+    FORI(1, size / 2) {
+        cqt->spectrum_re[i] = cqt->out[i];
+        cqt->spectrum_im[i] = cqt->out[size - i];
+    }
+    cqt->spectrum_re[size / 2] = cqt->out[size / 2];
+    cqt->spectrum_im[size / 2] = 0.0f;
+
+    // X * conj(K) summed over the kernel of each bin.
+    FORI(0, cqt->num_bins) {
+        float const* xr = cqt->spectrum_re + cqt->kernel_first[i];
+        float const* xi = cqt->spectrum_im + cqt->kernel_first[i];
+        float const* kr = cqt->kernel_re + cqt->kernel_offsets[i];
+        float const* ki = cqt->kernel_im + cqt->kernel_offsets[i];
+        int width = cqt->kernel_offsets[i + 1] - cqt->kernel_offsets[i];
+        float re = 0.0f;
+        float im = 0.0f;
+        for(int j = 0; j < width; j++) {
+            re += xr[j] * kr[j] + xi[j] * ki[j];
+            im += xi[j] * kr[j] - xr[j] * ki[j];
+        }
+        cqt->magnitudes[i] = sqrtf(re * re + im * im);
+    }
+}
+
+void copy_cqt_to_gpu(Cqt cqt) { copy_cqt_magnitudes_to_gpu(cqt, cqt->magnitudes); }
+
+void copy_cqt_magnitudes_to_gpu(Cqt cqt, float const* magnitudes) {
+    copy_buffer_to_gpu(cqt->buffer, magnitudes, 3 * sizeof(int), cqt->num_bins * isizeof(float));
+    commit_buffer_to_gpu(cqt->buffer);
+}
+
+void delete_cqt(Cqt cqt) {
+    delete_buffer(cqt->buffer);
+    fftwf_destroy_plan(cqt->plan);
+    fftwf_free(cqt->in);
+    fftwf_free(cqt->out);
+    free(cqt->right);
+    free(cqt->spectrum_re);
+    free(cqt->spectrum_im);
+    free(cqt->magnitudes);
+    free(cqt->kernel_first);
+    free(cqt->kernel_offsets);
+    free(cqt->kernel_re);
+    free(cqt->kernel_im);
+    free(cqt);
+}
@@ -1,7 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <sys/stat.h>
 
 #include <fftw3.h>
 
@@ -9,26 +15,152 @@
 #include "globals.h"
 #include "dft.h"
 #include "pcm.h"
+#include "simd.h"
+
+// Number of transforms done by one call of the batched plan.
+#define DFT_BATCH 4
 
 struct DftData_ {
     int size;
+    // Number of magnitudes per frame, `size / 2 + 1`.
+    int num_bins;
+    int sample_rate;
+    // Distance between the ends of consecutive frames.
+    int hop_size;
     float* hamming_window;
+
+    // Stereo packs left and right into one complex transform and gets mid,
+    // left, right and side magnitudes out of it. Mono transforms the mid only.
+    bool stereo;
+    int num_channels;
+    // Floats of transform input and output per frame, complex ones for stereo.
+    int frame_floats;
+    // One frame of both channels as copied out of the PCM ring.
+    float* left;
+    float* right;
+
+    // Frame queue, `frame_floats` samples and `num_channels * num_bins` magnitudes per frame.
+    // Slot 0 keeps the last frame of the previous call so there's always a current frame, new frames follow it.
+    int max_frames;
+    int num_frames;
+    int frame;
+    // Index of the sample after the end of each frame.
+    uint64_t* frame_ends;
+    // Frame end the next hop will have.
+    uint64_t next_frame_end;
+    // Frames that were overwritten in the PCM ring or didn't fit into the queue.
+    uint64_t dropped_frames;
+
     float* in;
     float* out;
+    float* magnitudes;
     fftwf_plan plan;
+    fftwf_plan batch_plan;
 
     Buffer buffer;
 };
 
-DftData create_dft_data(int dft_size, unsigned int index) {
-    assert(dft_size % 2 == 0);
+static unsigned int const planning_flags[] = {
+    [DFT_PLANNING_ESTIMATE] = FFTW_ESTIMATE,
+    [DFT_PLANNING_MEASURE] = FFTW_MEASURE,
+    [DFT_PLANNING_PATIENT] = FFTW_PATIENT,
+    [DFT_PLANNING_EXHAUSTIVE] = FFTW_EXHAUSTIVE,
+};
+
+__attribute__((const)) unsigned int fftw_flags_of_planning(enum DftPlanning planning) {
+    return planning_flags[planning];
+}
+
+bool load_dft_wisdom(char const* path) { return fftwf_import_wisdom_from_filename(path) != 0; }
+
+// Creates the missing directories of `path`.
+void make_parent_directories(char const* path) {
+    char* directory = strdup(path);
+    for(char* slash = strchr(directory + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(directory, 0755);
+        *slash = '/';
+    }
+    free(directory);
+}
+
+bool save_dft_wisdom(char const* path) {
+    // Write next to it and rename, so concurrent instances never read half a file.
+    make_parent_directories(path);
+    size_t temporary_size = strlen(path) + 5;
+    char* temporary_path = malloc(temporary_size);
+    snprintf(temporary_path, temporary_size, "%s.tmp", path);
+
+    bool is_saved = false;
+    FILE* file = fopen(temporary_path, "w");
+    if(file != NULL) {
+        fftwf_export_wisdom_to_file(file);
+        is_saved = fclose(file) == 0 && rename(temporary_path, path) == 0;
+    }
+    if(!is_saved) {
+        fprintf(stderr, "Could not save FFTW wisdom to %s\n", path);
+        remove(temporary_path);
+    }
+    free(temporary_path);
+    return is_saved;
+}
+
+DftData create_dft_data(int dft_size, int hop_size, int sample_rate, bool stereo, enum DftPlanning planning,
+                        unsigned int index) {
+    // Frames are 64 byte aligned within the queue, so every frame can reuse the plans.
+    assert(dft_size % 16 == 0);
+    assert(hop_size > 0);
     DftData dft_data = (DftData)malloc(sizeof(struct DftData_));
 
     dft_data->size = dft_size;
+    dft_data->num_bins = dft_size / 2 + 1;
+    dft_data->sample_rate = sample_rate;
+    dft_data->hop_size = hop_size;
     dft_data->hamming_window = malloc((size_t)dft_size * sizeof(float));
-    dft_data->in = fftwf_malloc((size_t)dft_size * sizeof(float));
-    dft_data->out = fftwf_malloc((size_t)dft_size * sizeof(fftwf_complex));
-    dft_data->plan = fftwf_plan_r2r_1d(dft_size, dft_data->in, dft_data->out, FFTW_R2HC, 0);
+
+    dft_data->stereo = stereo;
+    dft_data->num_channels = stereo ? 4 : 1;
+    dft_data->frame_floats = stereo ? 2 * dft_size : dft_size;
+    dft_data->left = ALLOCATE(dft_size, float);
+    dft_data->right = ALLOCATE(dft_size, float);
+
+    // Enough frames for ~200ms of audio before we start dropping.
+    int max_frames = MAX(2 * DFT_BATCH, sample_rate / 5 / hop_size);
+    dft_data->max_frames = max_frames;
+    dft_data->num_frames = 1;
+    dft_data->frame = 0;
+    dft_data->frame_ends = ALLOCATE(max_frames + 1, uint64_t);
+    dft_data->frame_ends[0] = 0;
+    dft_data->next_frame_end = (uint64_t)hop_size;
+    dft_data->dropped_frames = 0;
+
+    size_t queue_size = (size_t)(max_frames + 1) * (size_t)dft_data->frame_floats * sizeof(float);
+    dft_data->in = fftwf_malloc(queue_size);
+    dft_data->out = fftwf_malloc(queue_size);
+
+    // Anything but estimate tries out transforms, that's free with wisdom and seconds without.
+    double planning_start = get_monotonic_seconds();
+    unsigned int flags = fftw_flags_of_planning(planning);
+    if(stereo) {
+        fftwf_complex* in = (fftwf_complex*)dft_data->in;
+        fftwf_complex* out = (fftwf_complex*)dft_data->out;
+        dft_data->plan = fftwf_plan_dft_1d(dft_size, in, out, FFTW_FORWARD, flags);
+        dft_data->batch_plan = fftwf_plan_many_dft(1, &dft_size, DFT_BATCH, in, NULL, 1, dft_size, out, NULL, 1,
+                                                   dft_size, FFTW_FORWARD, flags);
+    } else {
+        dft_data->plan = fftwf_plan_r2r_1d(dft_size, dft_data->in, dft_data->out, FFTW_R2HC, flags);
+        fftwf_r2r_kind kind = FFTW_R2HC;
+        dft_data->batch_plan = fftwf_plan_many_r2r(1, &dft_size, DFT_BATCH, dft_data->in, NULL, 1, dft_size,
+                                                   dft_data->out, NULL, 1, dft_size, &kind, flags);
+    }
+    printf("Planned the %d point %s DFT in %.1f ms\n", dft_size, stereo ? "stereo" : "mono",
+           1000.0 * (get_monotonic_seconds() - planning_start));
+
+    // Planning overwrites the arrays.
+    memset(dft_data->out, 0, queue_size);
+    int magnitudes_size = (max_frames + 1) * dft_data->num_channels * dft_data->num_bins;
+    dft_data->magnitudes = ALLOCATE(magnitudes_size, float);
+    memset(dft_data->magnitudes, 0, (size_t)magnitudes_size * sizeof(float));
 
     for(int i = 0; i < dft_data->size; i++) {
         dft_data->hamming_window[i] = 0.54f - (0.46f * cosf(2.f * PI * ((float)i / (float)(dft_data->size - 1))));
@@ -38,41 +170,183 @@ DftData create_dft_data(int dft_size, unsigned int index) {
     // For reference see:
     // https://www.uni-weimar.de/fileadmin/user/fak/medien/professuren/Computer_Graphics/CG_WS_18_19/CG/06_ShaderBuffers.pdf
 
-    int gpu_buffer_size = isizeof(int) + dft_size * isizeof(float);
+    int gpu_buffer_size = 2 * isizeof(int) + dft_data->num_channels * dft_data->num_bins * isizeof(float);
 
-    dft_data->buffer = create_storage_buffer(gpu_buffer_size, index);
+    dft_data->buffer = create_streaming_storage_buffer(gpu_buffer_size, index);
     copy_buffer_to_gpu(dft_data->buffer, (char*)&dft_size, 0, sizeof(int));
+    copy_buffer_to_gpu(dft_data->buffer, (char*)&dft_data->num_channels, sizeof(int), sizeof(int));
+    commit_buffer_to_gpu(dft_data->buffer);
 
     return dft_data;
 }
 
 __attribute__((pure)) int size_of_dft(DftData dft_data) { return dft_data->size; }
 
-__attribute__((pure)) float dft_at(DftData dft_data, int index) {
-    bool first_or_last = index == 0 || index == dft_data->size / 2;
-    float second = first_or_last ? 0.0f : dft_data->out[dft_data->size - index];
-    return sqrtf(powf(dft_data->out[index], 2.0) + powf(second, 2));
+__attribute__((pure)) int sample_rate_of_dft(DftData dft_data) { return dft_data->sample_rate; }
+
+__attribute__((pure)) int hop_size_of_dft(DftData dft_data) { return dft_data->hop_size; }
+
+__attribute__((pure)) uint64_t sample_index_of_dft(DftData dft_data) { return dft_data->frame_ends[dft_data->frame]; }
+
+__attribute__((pure)) uint64_t dropped_frames_of_dft(DftData dft_data) { return dft_data->dropped_frames; }
+
+__attribute__((pure)) int num_channels_of_dft(DftData dft_data) { return dft_data->num_channels; }
+
+__attribute__((pure)) float const* channel_magnitudes_of_dft(DftData dft_data, enum DftChannel channel) {
+    assert((int)channel < dft_data->num_channels);
+    int frame_size = dft_data->num_channels * dft_data->num_bins;
+    return dft_data->magnitudes + dft_data->frame * frame_size + (int)channel * dft_data->num_bins;
 }
 
-void compute_and_copy_dft_data_to_gpu(Pcm pcm, DftData dft_data) {
-    copy_pcm_mono_to_buffer(dft_data->in, pcm, dft_data->size);
+__attribute__((pure)) float const* magnitudes_of_dft(DftData dft_data) {
+    return channel_magnitudes_of_dft(dft_data, DFT_CHANNEL_MID);
+}
 
-    // Multiply with Hamming window.
-    for(int i = 0; i < dft_data->size; i++) {
-        dft_data->in[i] *= dft_data->hamming_window[i];
+__attribute__((pure)) float dft_at(DftData dft_data, int index) { return magnitudes_of_dft(dft_data)[index]; }
+
+__attribute__((pure)) float const* queued_magnitudes_of_dft(DftData dft_data, int frame) {
+    assert(frame >= 0 && frame + 1 < dft_data->num_frames);
+    return dft_data->magnitudes + (frame + 1) * dft_data->num_channels * dft_data->num_bins;
+}
+
+// Splits the spectrum Z of left + i * right into the mid, left, right and side magnitudes:
+// L[k] = (Z[k] + conj(Z[N - k])) / 2 and R[k] = (Z[k] - conj(Z[N - k])) / 2i.
+void separate_stereo_magnitudes(float const* spectrum, int size, int num_bins, float* magnitudes) {
+    float* mid = magnitudes;
+    float* left = magnitudes + num_bins;
+    float* right = magnitudes + 2 * num_bins;
+    float* side = magnitudes + 3 * num_bins;
+    FORI(0, num_bins) {
+        int mirror = (size - i) % size;
+        float zr = spectrum[2 * i];
+        float zi = spectrum[2 * i + 1];
+        float cr = spectrum[2 * mirror];
+        float ci = -spectrum[2 * mirror + 1];
+
+        float lr = 0.5f * (zr + cr);
+        float li = 0.5f * (zi + ci);
+        float rr = 0.5f * (zi - ci);
+        float ri = -0.5f * (zr - cr);
+
+        left[i] = sqrtf(lr * lr + li * li);
+        right[i] = sqrtf(rr * rr + ri * ri);
+        mid[i] = 0.5f * sqrtf((lr + rr) * (lr + rr) + (li + ri) * (li + ri));
+        side[i] = 0.5f * sqrtf((lr - rr) * (lr - rr) + (li - ri) * (li - ri));
+    }
+}
+
+void transform_dft_frame(DftData dft_data, fftwf_plan plan, int frame) {
+    float* in = dft_data->in + frame * dft_data->frame_floats;
+    float* out = dft_data->out + frame * dft_data->frame_floats;
+    if(dft_data->stereo) {
+        fftwf_execute_dft(plan, (fftwf_complex*)in, (fftwf_complex*)out);
+    } else {
+        fftwf_execute_r2r(plan, in, out);
     }
-    fftwf_execute(dft_data->plan);
+}
+
+int compute_dft_frames(Pcm pcm, DftData dft_data) {
+    int const size = dft_data->size;
+    uint64_t const hop = (uint64_t)dft_data->hop_size;
+    uint64_t end = consume_pcm(pcm).end;
+    if(dft_data->next_frame_end > end) {
+        return 0;
+    }
+
+    // Skip the oldest hops if we fell too far behind.
+    uint64_t num_pending = (end - dft_data->next_frame_end) / hop + 1;
+    if(num_pending > (uint64_t)dft_data->max_frames) {
+        uint64_t num_skipped = num_pending - (uint64_t)dft_data->max_frames;
+        dft_data->dropped_frames += num_skipped;
+        dft_data->next_frame_end += num_skipped * hop;
+        num_pending = (uint64_t)dft_data->max_frames;
+    }
+
+    // Keep the current frame around as slot 0.
+    int const num_bins = dft_data->num_bins;
+    int const frame_size = dft_data->num_channels * num_bins;
+    if(dft_data->frame != 0) {
+        memcpy(dft_data->magnitudes, magnitudes_of_dft(dft_data), (size_t)frame_size * sizeof(float));
+        dft_data->frame_ends[0] = dft_data->frame_ends[dft_data->frame];
+    }
+
+    // Gather and window the new frames, the ones the producer already overwrote are lost.
+    int num_frames = 1;
+    FORI(0, (int)num_pending) {
+        uint64_t frame_end = dft_data->next_frame_end;
+        dft_data->next_frame_end += hop;
+
+        if(!copy_pcm_window(pcm, frame_end, size, dft_data->left, dft_data->right)) {
+            dft_data->dropped_frames++;
+            continue;
+        }
+        float* in = dft_data->in + num_frames * dft_data->frame_floats;
+        if(dft_data->stereo) {
+            interleave_window(dft_data->left, dft_data->right, dft_data->hamming_window, in, size);
+        } else {
+            mix_window(dft_data->left, dft_data->right, dft_data->hamming_window, in, size);
+        }
+        dft_data->frame_ends[num_frames] = frame_end;
+        num_frames++;
+    }
+
+    // Whole batches first, then one by one.
+    int frame = 1;
+    for(; frame + DFT_BATCH <= num_frames; frame += DFT_BATCH) {
+        transform_dft_frame(dft_data, dft_data->batch_plan, frame);
+    }
+    for(; frame < num_frames; frame++) {
+        transform_dft_frame(dft_data, dft_data->plan, frame);
+    }
+    for(frame = 1; frame < num_frames; frame++) {
+        float const* out = dft_data->out + frame * dft_data->frame_floats;
+        float* magnitudes = dft_data->magnitudes + frame * frame_size;
+        if(dft_data->stereo) {
+            separate_stereo_magnitudes(out, size, num_bins, magnitudes);
+        } else {
+            halfcomplex_magnitudes(out, size, magnitudes);
+        }
+    }
+
+    dft_data->num_frames = num_frames;
+    dft_data->frame = 0;
+    return num_frames - 1;
+}
+
+bool next_dft_frame(DftData dft_data) {
+    if(dft_data->frame + 1 >= dft_data->num_frames) {
+        return false;
+    }
+    dft_data->frame++;
+    return true;
+}
+
+__attribute__((pure)) float const* newest_magnitudes_of_dft(DftData dft_data) {
+    return dft_data->magnitudes + (dft_data->num_frames - 1) * dft_data->num_channels * dft_data->num_bins;
+}
+
+void copy_dft_data_to_gpu(DftData dft_data) {
+    // Shaders only see the newest frame.
+    copy_dft_magnitudes_to_gpu(dft_data, newest_magnitudes_of_dft(dft_data));
+}
 
-    int buffer_size = dft_data->size * isizeof(float);
-    copy_buffer_to_gpu(dft_data->buffer, (char*)dft_data->out, sizeof(int), buffer_size);
+void copy_dft_magnitudes_to_gpu(DftData dft_data, float const* magnitudes) {
+    int frame_size = dft_data->num_channels * dft_data->num_bins;
+    copy_buffer_to_gpu(dft_data->buffer, magnitudes, 2 * sizeof(int), frame_size * isizeof(float));
+    commit_buffer_to_gpu(dft_data->buffer);
 }
 
 void delete_dft_data(DftData dft_data) {
     delete_buffer(dft_data->buffer);
 
+    fftwf_destroy_plan(dft_data->batch_plan);
     fftwf_destroy_plan(dft_data->plan);
     fftwf_free(dft_data->in);
     fftwf_free(dft_data->out);
+    free(dft_data->magnitudes);
+    free(dft_data->frame_ends);
+    free(dft_data->left);
+    free(dft_data->right);
     free(dft_data->hamming_window);
     free(dft_data);
 }
@@ -0,0 +1,169 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buffers.h"
+#include "filterbank.h"
+#include "globals.h"
+#include "simd.h"
+
+struct Filterbank_ {
+    int num_bands;
+    enum FilterbankScale scale;
+    float min_hz;
+    float max_hz;
+
+    // Weights in CSR form, band `i` sums `weights[j] * magnitudes[columns[j]]`
+    // for `j` in `[row_offsets[i], row_offsets[i + 1])`.
+    int* row_offsets;
+    int* columns;
+    float* weights;
+
+    float* centers;
+    float* bands;
+
+    Buffer buffer;
+};
+
+__attribute__((const)) float scale_of_frequency(enum FilterbankScale scale, float hz) {
+    switch(scale) {
+    case FILTERBANK_MEL:
+        return 2595.0f * log10f(1.0f + hz / 700.0f);
+    case FILTERBANK_LOG:
+        return log2f(hz);
+    case FILTERBANK_BARK:
+        // Traunmüller's approximation.
+        return 26.81f * hz / (1960.0f + hz) - 0.53f;
+    default:
+        fprintf(stderr, "Unknown filterbank scale %d\n", scale);
+        exit(1);
+    }
+}
+
+__attribute__((const)) float frequency_of_scale(enum FilterbankScale scale, float value) {
+    switch(scale) {
+    case FILTERBANK_MEL:
+        return 700.0f * (powf(10.0f, value / 2595.0f) - 1.0f);
+    case FILTERBANK_LOG:
+        return exp2f(value);
+    case FILTERBANK_BARK:
+        return 1960.0f * (value + 0.53f) / (26.28f - value);
+    default:
+        fprintf(stderr, "Unknown filterbank scale %d\n", scale);
+        exit(1);
+    }
+}
+
+Filterbank create_filterbank(DftData dft_data, int num_bands, enum FilterbankScale scale, float min_hz, float max_hz,
+                             unsigned int index) {
+    Filterbank filterbank = ALLOCATE(1, struct Filterbank_);
+    int dft_size = size_of_dft(dft_data);
+    int num_bins = dft_size / 2 + 1;
+    float bin_hz = (float)sample_rate_of_dft(dft_data) / (float)dft_size;
+    max_hz = MIN(max_hz, (float)(num_bins - 1) * bin_hz);
+    if(num_bands < 1 || min_hz <= 0.0f || min_hz >= max_hz) {
+        fprintf(stderr, "Invalid filterbank: %d bands from %.1f to %.1f Hz\n", num_bands, (double)min_hz,
+                (double)max_hz);
+        exit(1);
+    }
+    filterbank->num_bands = num_bands;
+    filterbank->scale = scale;
+    filterbank->min_hz = min_hz;
+    filterbank->max_hz = max_hz;
+
+    // Band `i` rises from edge `i` to its center at edge `i + 1` and falls to edge `i + 2`.
+    float* edges = ALLOCATE(num_bands + 2, float);
+    float lo = scale_of_frequency(scale, min_hz);
+    float hi = scale_of_frequency(scale, max_hz);
+    FORI(0, num_bands + 2) { edges[i] = frequency_of_scale(scale, lo + (hi - lo) * (float)i / (float)(num_bands + 1)); }
+
+    // No band covers more bins than lie between its outer edges.
+    int max_values = 0;
+    FORI(0, num_bands) { max_values += (int)ceilf((edges[i + 2] - edges[i]) / bin_hz) + 1; }
+    filterbank->row_offsets = ALLOCATE(num_bands + 1, int);
+    filterbank->columns = ALLOCATE(max_values, int);
+    filterbank->weights = ALLOCATE(max_values, float);
+    filterbank->centers = ALLOCATE(num_bands, float);
+    filterbank->bands = ALLOCATE(num_bands, float);
+    memset(filterbank->bands, 0, (size_t)num_bands * sizeof(float));
+
+    int num_values = 0;
+    filterbank->row_offsets[0] = 0;
+    FORI(0, num_bands) {
+        float left = edges[i];
+        float center = edges[i + 1];
+        float right = edges[i + 2];
+        filterbank->centers[i] = center;
+
+        int first = num_values;
+        float sum = 0.0f;
+        for(int bin = (int)ceilf(left / bin_hz); bin <= (int)floorf(right / bin_hz) && bin < num_bins; bin++) {
+            float hz = (float)bin * bin_hz;
+            float weight = hz < center ? (hz - left) / (center - left) : (right - hz) / (right - center);
+            if(weight > 0.0f) {
+                filterbank->columns[num_values] = bin;
+                filterbank->weights[num_values] = weight;
+                sum += weight;
+                num_values++;
+            }
+        }
+        if(num_values == first) {
+            // Bass bands narrower than a bin take the nearest one.
+            filterbank->columns[num_values] = MIN((int)roundf(center / bin_hz), num_bins - 1);
+            filterbank->weights[num_values] = 1.0f;
+            sum = 1.0f;
+            num_values++;
+        }
+        // Averages, so that wide bands don't dwarf narrow ones.
+        for(int j = first; j < num_values; j++) {
+            filterbank->weights[j] /= sum;
+        }
+        filterbank->row_offsets[i + 1] = num_values;
+    }
+    free(edges);
+
+    printf("Filterbank: %d bands from %.1f to %.0f Hz, %d weights\n", num_bands, (double)min_hz, (double)max_hz,
+           num_values);
+
+    // Header followed by the bands, see `filterbank_data` in the shaders.
+    int gpu_buffer_size = 4 * isizeof(int) + num_bands * isizeof(float);
+    filterbank->buffer = create_streaming_storage_buffer(gpu_buffer_size, index);
+    int header[2] = {num_bands, (int)scale};
+    float range[2] = {min_hz, max_hz};
+    copy_buffer_to_gpu(filterbank->buffer, (char*)header, 0, isizeof(header));
+    copy_buffer_to_gpu(filterbank->buffer, (char*)range, isizeof(header), isizeof(range));
+    commit_buffer_to_gpu(filterbank->buffer);
+
+    return filterbank;
+}
+
+__attribute__((pure)) int num_bands_of_filterbank(Filterbank filterbank) { return filterbank->num_bands; }
+
+__attribute__((pure)) float frequency_of_filterbank_band(Filterbank filterbank, int band) {
+    return filterbank->centers[band];
+}
+
+__attribute__((pure)) float const* bands_of_filterbank(Filterbank filterbank) { return filterbank->bands; }
+
+void compute_filterbank(DftData dft_data, Filterbank filterbank) {
+    sparse_matrix_vector(filterbank->num_bands, filterbank->row_offsets, filterbank->columns, filterbank->weights,
+                         magnitudes_of_dft(dft_data), filterbank->bands);
+}
+
+void copy_filterbank_to_gpu(Filterbank filterbank) { copy_filterbank_bands_to_gpu(filterbank, filterbank->bands); }
+
+void copy_filterbank_bands_to_gpu(Filterbank filterbank, float const* bands) {
+    copy_buffer_to_gpu(filterbank->buffer, bands, 4 * isizeof(int), filterbank->num_bands * isizeof(float));
+    commit_buffer_to_gpu(filterbank->buffer);
+}
+
+void delete_filterbank(Filterbank filterbank) {
+    delete_buffer(filterbank->buffer);
+    free(filterbank->row_offsets);
+    free(filterbank->columns);
+    free(filterbank->weights);
+    free(filterbank->centers);
+    free(filterbank->bands);
+    free(filterbank);
+}
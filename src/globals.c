@@ -1,3 +1,14 @@
+// Required for clock_gettime.
+#define _POSIX_C_SOURCE 199309L
+
+#include <time.h>
+
 #include"globals.h"
 
 __attribute__((const)) float mix(float a, float b, float x) { return a + (b - a) * x; }
+
+double get_monotonic_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+}
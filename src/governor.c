@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "globals.h"
+#include "governor.h"
+
+// Frames of timestamp queries in flight, results are usually there two frames later.
+#define GOVERNOR_QUERIES 4
+#define GOVERNOR_MIN_SCALE 0.25f
+// How fast the average GPU time follows new frames.
+#define GOVERNOR_SMOOTHING 0.1
+// Frames to measure after a change before deciding again.
+#define GOVERNOR_SETTLE_FRAMES 10
+// Scaling up waits until the next step is predicted to stay this far below the
+// budget for this many frames, so the scale doesn't flip back and forth.
+#define GOVERNOR_STEP 0.05f
+#define GOVERNOR_HEADROOM 0.8
+#define GOVERNOR_UP_FRAMES 60
+// Every change reallocates the images, which clears the previous frames that
+// feedback effects build on. So changes are at least this many seconds apart,
+// going down sooner than going up, and scales are multiples of the step, so
+// small swings of the GPU time don't land on a new size each time.
+#define GOVERNOR_DOWN_INTERVAL_S 1.0
+#define GOVERNOR_UP_INTERVAL_S 5.0
+// Seconds between two stats lines.
+#define GOVERNOR_STATS_INTERVAL_S 2.0
+
+struct Governor_ {
+    double frame_budget_s;
+    float max_scale;
+    float scale;
+
+    // Timestamps before and after the dispatches. Unlike GL_TIME_ELAPSED
+    // they also catch compute work that Mesa's llvmpipe runs lazily.
+    GLuint queries[GOVERNOR_QUERIES][2];
+    // Scale changes a query was started after, older results are of another size.
+    uint64_t query_generations[GOVERNOR_QUERIES];
+    bool query_pending[GOVERNOR_QUERIES];
+    int query;
+    bool measuring;
+    uint64_t generation;
+
+    double gpu_s;
+    int num_frames;
+    int up_frames;
+    double change_s;
+
+    bool stats;
+    double stats_start;
+};
+
+Governor create_governor(double frame_budget_s, float max_scale, bool stats) {
+    Governor governor = ALLOCATE(1, struct Governor_);
+    governor->frame_budget_s = frame_budget_s;
+    governor->max_scale = max_scale;
+    governor->scale = max_scale;
+
+    glGenQueries(2 * GOVERNOR_QUERIES, governor->queries[0]);
+    FORI(0, GOVERNOR_QUERIES) {
+        governor->query_generations[i] = 0;
+        governor->query_pending[i] = false;
+    }
+    governor->query = 0;
+    governor->measuring = false;
+    governor->generation = 0;
+
+    governor->gpu_s = 0.0;
+    governor->num_frames = 0;
+    governor->up_frames = 0;
+    governor->change_s = get_monotonic_seconds();
+
+    governor->stats = stats;
+    governor->stats_start = get_monotonic_seconds();
+    return governor;
+}
+
+void set_render_scale(Governor governor, float scale) {
+    scale = CLAMP(scale, GOVERNOR_MIN_SCALE, governor->max_scale);
+    if(fabsf(scale - governor->scale) < 0.01f) {
+        return;
+    }
+    governor->scale = scale;
+    governor->generation++;
+    governor->num_frames = 0;
+    governor->up_frames = 0;
+    governor->change_s = get_monotonic_seconds();
+}
+
+void add_gpu_time(Governor governor, double gpu_s) {
+    if(governor->num_frames == 0) {
+        governor->gpu_s = gpu_s;
+    }
+    governor->gpu_s += GOVERNOR_SMOOTHING * (gpu_s - governor->gpu_s);
+    governor->num_frames++;
+    if(governor->frame_budget_s <= 0.0 || governor->num_frames < GOVERNOR_SETTLE_FRAMES) {
+        return;
+    }
+
+    // The cost is about proportional to the pixels, aim a little below the budget right away.
+    float scale = governor->scale;
+    double since_change_s = get_monotonic_seconds() - governor->change_s;
+    if(governor->gpu_s > governor->frame_budget_s) {
+        if(since_change_s >= GOVERNOR_DOWN_INTERVAL_S) {
+            float down = scale * sqrtf((float)(0.9 * governor->frame_budget_s / governor->gpu_s));
+            set_render_scale(governor, floorf(down / GOVERNOR_STEP) * GOVERNOR_STEP);
+        }
+        return;
+    }
+
+    float up = MIN(scale + GOVERNOR_STEP, governor->max_scale);
+    double predicted_s = governor->gpu_s * (double)(up * up / (scale * scale));
+    if(up > scale && predicted_s < GOVERNOR_HEADROOM * governor->frame_budget_s) {
+        governor->up_frames++;
+    } else {
+        governor->up_frames = 0;
+    }
+    if(governor->up_frames >= GOVERNOR_UP_FRAMES && since_change_s >= GOVERNOR_UP_INTERVAL_S) {
+        set_render_scale(governor, up);
+    }
+}
+
+void begin_governed_frame(Governor governor) {
+    int query = governor->query;
+    GLuint* queries = governor->queries[query];
+    if(governor->query_pending[query]) {
+        // The end is available after the start.
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(!available) {
+            // The GPU is far behind, rather skip a frame than wait for it.
+            governor->measuring = false;
+            return;
+        }
+        GLuint64 start_ns;
+        GLuint64 end_ns;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &start_ns);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &end_ns);
+        governor->query_pending[query] = false;
+        if(governor->query_generations[query] == governor->generation) {
+            add_gpu_time(governor, 1e-9 * (double)(end_ns - start_ns));
+        }
+    }
+
+    glQueryCounter(queries[0], GL_TIMESTAMP);
+    governor->query_generations[query] = governor->generation;
+    governor->measuring = true;
+}
+
+void print_governor_stats(Governor governor) {
+    double now = get_monotonic_seconds();
+    if(now - governor->stats_start < GOVERNOR_STATS_INTERVAL_S) {
+        return;
+    }
+    printf("Render: scale %.2f, GPU %.3f ms per frame, budget %.1f ms\n", (double)governor->scale,
+           1000.0 * governor->gpu_s, 1000.0 * governor->frame_budget_s);
+    governor->stats_start = now;
+}
+
+void end_governed_frame(Governor governor) {
+    if(governor->measuring) {
+        glQueryCounter(governor->queries[governor->query][1], GL_TIMESTAMP);
+        governor->query_pending[governor->query] = true;
+        governor->query = (governor->query + 1) % GOVERNOR_QUERIES;
+    }
+
+    if(governor->stats) {
+        print_governor_stats(governor);
+    }
+}
+
+__attribute__((pure)) float render_scale_of_governor(Governor governor) { return governor->scale; }
+
+__attribute__((pure)) struct Size render_size_of_governor(Governor governor, struct Size window_size) {
+    int w = (int)((float)window_size.w * governor->scale);
+    int h = (int)((float)window_size.h * governor->scale);
+    return (struct Size){.w = MAX(w, 1), .h = MAX(h, 1)};
+}
+
+void delete_governor(Governor governor) {
+    glDeleteQueries(2 * GOVERNOR_QUERIES, governor->queries[0]);
+    free(governor);
+}
@@ -0,0 +1,34 @@
+// GPU buffers are not available in the headless build, uploads do nothing.
+
+#include <stddef.h>
+
+#include "buffers.h"
+
+__attribute__((const)) Buffer create_uniform_buffer(int size, unsigned int index) {
+    (void)size;
+    (void)index;
+    return NULL;
+}
+
+__attribute__((const)) Buffer create_storage_buffer(int size, unsigned int index) {
+    return create_uniform_buffer(size, index);
+}
+
+__attribute__((const)) Buffer create_streaming_uniform_buffer(int size, unsigned int index) {
+    return create_uniform_buffer(size, index);
+}
+
+__attribute__((const)) Buffer create_streaming_storage_buffer(int size, unsigned int index) {
+    return create_uniform_buffer(size, index);
+}
+
+void copy_buffer_to_gpu(Buffer buffer, void const* data, int buffer_offset, int size) {
+    (void)buffer;
+    (void)data;
+    (void)buffer_offset;
+    (void)size;
+}
+
+void commit_buffer_to_gpu(Buffer buffer) { (void)buffer; }
+
+void delete_buffer(Buffer buffer) { (void)buffer; }
@@ -0,0 +1,103 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "columnar.h"
+#include "globals.h"
+
+_Static_assert(sizeof(struct ColumnarHeader) == 64, "columnar headers must stay 64 bytes");
+_Static_assert(sizeof(struct ColumnHeader) == 64, "columnar headers must stay 64 bytes");
+
+struct Columnar_ {
+    char* mapping;
+    size_t size;
+    uint64_t max_rows;
+
+    struct ColumnarHeader* header;
+    struct ColumnHeader* columns;
+};
+
+__attribute__((const)) int size_of_column_type(enum ColumnType type) {
+    switch(type) {
+    case COLUMN_TYPE_F32:
+    case COLUMN_TYPE_I32:
+        return 4;
+    case COLUMN_TYPE_U64:
+        return 8;
+    default:
+        fprintf(stderr, "Unknown column type %d\n", type);
+        exit(1);
+    }
+}
+
+__attribute__((const)) uint64_t align_64(uint64_t offset) { return (offset + 63) / 64 * 64; }
+
+Columnar create_columnar(char const* path, struct ColumnSpec const* specs, int num_columns, uint64_t max_rows,
+                         struct ColumnarHeader metadata) {
+    Columnar columnar = (Columnar)malloc(sizeof(struct Columnar_));
+    columnar->max_rows = max_rows;
+
+    // Lay out the columns one after the other.
+    uint64_t* offsets = ALLOCATE(num_columns, uint64_t);
+    uint64_t offset = sizeof(struct ColumnarHeader) + (uint64_t)num_columns * sizeof(struct ColumnHeader);
+    FORI(0, num_columns) {
+        offset = align_64(offset);
+        offsets[i] = offset;
+        offset += max_rows * (uint64_t)(specs[i].width * size_of_column_type(specs[i].type));
+    }
+    columnar->size = (size_t)MAX(offset, 1);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1 || ftruncate(fd, (off_t)columnar->size) != 0) {
+        fprintf(stderr, "%s: cannot create file\n", path);
+        exit(1);
+    }
+    columnar->mapping = mmap(NULL, columnar->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(columnar->mapping == MAP_FAILED) {
+        fprintf(stderr, "%s: failed to mmap\n", path);
+        exit(1);
+    }
+
+    columnar->header = (struct ColumnarHeader*)(void*)columnar->mapping;
+    *columnar->header = metadata;
+    memcpy(columnar->header->magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC));
+    columnar->header->version = COLUMNAR_VERSION;
+    columnar->header->num_columns = (uint32_t)num_columns;
+    columnar->header->num_rows = 0;
+
+    columnar->columns = (struct ColumnHeader*)(void*)(columnar->mapping + sizeof(struct ColumnarHeader));
+    FORI(0, num_columns) {
+        struct ColumnHeader* column = columnar->columns + i;
+        memset(column, 0, sizeof(struct ColumnHeader));
+        strncpy(column->name, specs[i].name, sizeof(column->name) - 1);
+        column->type = (uint32_t)specs[i].type;
+        column->width = (uint32_t)specs[i].width;
+        column->offset = offsets[i];
+    }
+
+    free(offsets);
+    return columnar;
+}
+
+__attribute__((pure)) void* columnar_cell(Columnar columnar, int column_index, uint64_t row) {
+    struct ColumnHeader const* column = columnar->columns + column_index;
+    uint64_t row_size = column->width * (uint64_t)size_of_column_type((enum ColumnType)column->type);
+    return columnar->mapping + column->offset + row * row_size;
+}
+
+void set_columnar_num_rows(Columnar columnar, uint64_t num_rows) {
+    columnar->header->num_rows = MIN(num_rows, columnar->max_rows);
+}
+
+void delete_columnar(Columnar columnar) {
+    munmap(columnar->mapping, columnar->size);
+    free(columnar);
+}
@@ -0,0 +1,334 @@
+// Analyse a file without SDL or OpenGL and write the results to a columnar
+// file, see `columnar.h`. Rows are written per hop.
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "columnar.h"
+#include "cqt.h"
+#include "filterbank.h"
+#include "dft.h"
+#include "globals.h"
+#include "options.h"
+#include "pcm.h"
+#include "pcm_file.h"
+
+enum Column {
+    COLUMN_SAMPLE_INDEX,
+    COLUMN_IS_BEAT,
+    COLUMN_BEATS,
+    COLUMN_BPM,
+    COLUMN_BAND_ACCUMULATED,
+    COLUMN_BAND_WINDOW,
+    COLUMN_BAND_SMOOTH_WINDOW,
+    COLUMN_BAND_DELTA2,
+    COLUMN_BAND_MOVEMENT,
+    COLUMN_BEAT_HZ,
+    COLUMN_BEAT_NOISE_THRESHOLD,
+    COLUMN_BEAT_SHORT_AVERAGE,
+    COLUMN_BEAT_THRESHOLD,
+    COLUMN_BEAT_CURRENT,
+    COLUMN_BEAT_SD_THRESHOLD,
+    COLUMN_BEAT_IS_BEAT,
+    COLUMN_FEATURE_FLUX,
+    COLUMN_FEATURE_CENTROID,
+    COLUMN_FEATURE_SPREAD,
+    COLUMN_FEATURE_ROLLOFF,
+    COLUMN_FEATURE_FLATNESS,
+    COLUMN_FEATURE_CREST,
+    COLUMN_TEMPO_BPM,
+    COLUMN_TEMPO_PHASE,
+    COLUMN_TEMPO_CONFIDENCE,
+    COLUMN_BEAT_EVENTS,
+    COLUMN_MAGNITUDE,
+    COLUMN_CQT,
+    COLUMN_FILTERBANK,
+    NUM_COLUMNS,
+};
+
+struct HeadlessOptions {
+    struct PcmFormat raw_format;
+    int hop_size;
+    int dft_size;
+    bool spectra;
+    int cqt_bins_per_octave;
+    int filterbank_bands;
+    enum FilterbankScale filterbank_scale;
+    struct BandLayout band_layout;
+    enum DftPlanning planning;
+    char const* wisdom_path;
+    char const* input_path;
+    char const* output_path;
+};
+
+void print_headless_usage(char const* program_name) {
+    fprintf(stderr, "Usage: %s [OPTION]... INPUT OUTPUT\n", program_name);
+    fprintf(stderr, "Analyse a WAV, AU or raw PCM file and write per-hop results to OUTPUT.\n\n");
+    fprintf(stderr, "  -f, --format=FORMAT    raw sample format (default f32le)\n");
+    fprintf(stderr, "  -c, --channels=N       raw channel count, 1 to 8 (default 2)\n");
+    fprintf(stderr, "  -r, --rate=HZ          raw sample rate (default 44100)\n");
+    fprintf(stderr, "  -H, --hop=SAMPLES      samples per row (default 512)\n");
+    fprintf(stderr, "  -s, --spectra          also write magnitude spectra\n");
+    fprintf(stderr, "  -Q, --cqt-bins=N       constant-Q bins per octave, 6 to 96 (default 24)\n");
+    fprintf(stderr, "  -B, --bands=N          filterbank bands, 1 to 1024 (default 64)\n");
+    fprintf(stderr, "  -F, --filterbank=SCALE filterbank spacing: mel, log, bark (default mel)\n");
+    fprintf(stderr, "  -e, --band-edges=LIST  comma separated band edges in Hz, or a band count up to 64\n");
+    fprintf(stderr, "  -P, --planning=LEVEL   FFTW planning: estimate, measure, patient, exhaustive (default measure)\n");
+    fprintf(stderr, "  -W, --wisdom=FILE      FFTW wisdom cache, empty to disable (default ~/.cache/...)\n");
+    fprintf(stderr, "  -h, --help             show this help\n");
+}
+
+struct HeadlessOptions parse_headless_options(int argc, char* argv[]) {
+    struct HeadlessOptions options = {
+        .raw_format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = 44100},
+        .hop_size = 512,
+        .dft_size = 4096,
+        .spectra = false,
+        .cqt_bins_per_octave = 24,
+        .filterbank_bands = 64,
+        .filterbank_scale = FILTERBANK_MEL,
+        .band_layout = default_band_layout(),
+        .planning = DFT_PLANNING_MEASURE,
+        .wisdom_path = default_wisdom_path(),
+        .input_path = NULL,
+        .output_path = NULL,
+    };
+
+    struct option const long_options[] = {
+        {"format", required_argument, NULL, 'f'},     {"channels", required_argument, NULL, 'c'},
+        {"rate", required_argument, NULL, 'r'},       {"hop", required_argument, NULL, 'H'},
+        {"spectra", no_argument, NULL, 's'},          {"planning", required_argument, NULL, 'P'},
+        {"wisdom", required_argument, NULL, 'W'},     {"cqt-bins", required_argument, NULL, 'Q'},
+        {"bands", required_argument, NULL, 'B'},      {"filterbank", required_argument, NULL, 'F'},
+        {"band-edges", required_argument, NULL, 'e'}, {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int option;
+    while((option = getopt_long(argc, argv, "f:c:r:H:sQ:B:F:e:P:W:h", long_options, NULL)) != -1) {
+        switch(option) {
+        case 'f':
+            if(!parse_sample_format(optarg, &options.raw_format.sample_format)) {
+                fprintf(stderr, "%s: unknown sample format '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'c':
+            options.raw_format.channels = parse_int_option(argv[0], optarg, 1, 8, print_headless_usage);
+            break;
+        case 'r':
+            options.raw_format.sample_rate = parse_int_option(argv[0], optarg, 1000, 768000, print_headless_usage);
+            break;
+        case 'H':
+            options.hop_size = parse_int_option(argv[0], optarg, 1, 1 << 20, print_headless_usage);
+            break;
+        case 's':
+            options.spectra = true;
+            break;
+        case 'Q':
+            options.cqt_bins_per_octave = parse_int_option(argv[0], optarg, 6, 96, print_headless_usage);
+            break;
+        case 'B':
+            options.filterbank_bands = parse_int_option(argv[0], optarg, 1, 1024, print_headless_usage);
+            break;
+        case 'F':
+            if(!parse_filterbank_scale(optarg, &options.filterbank_scale)) {
+                fprintf(stderr, "%s: unknown filterbank scale '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'e':
+            if(!parse_band_edges(optarg, &options.band_layout)) {
+                fprintf(stderr, "%s: invalid band edges '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'P':
+            if(!parse_dft_planning(optarg, &options.planning)) {
+                fprintf(stderr, "%s: unknown planning level '%s'\n", argv[0], optarg);
+                exit(1);
+            }
+            break;
+        case 'W':
+            options.wisdom_path = optarg[0] == '\0' ? NULL : optarg;
+            break;
+        case 'h':
+            print_headless_usage(argv[0]);
+            exit(0);
+        default:
+            print_headless_usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    if(argc - optind != 2) {
+        print_headless_usage(argv[0]);
+        exit(1);
+    }
+    options.input_path = argv[optind];
+    options.output_path = argv[optind + 1];
+
+    return options;
+}
+
+void write_row(Columnar columnar, uint64_t row, DftData dft_data, Cqt cqt, Filterbank filterbank, Analysis analysis,
+               BeatEvents beat_events, bool spectra) {
+    struct GpuData const* data = gpu_data_of_analysis(analysis);
+
+#define CELL(column, type) ((type*)columnar_cell(columnar, (column), row))
+    *CELL(COLUMN_SAMPLE_INDEX, uint64_t) = sample_index_of_dft(dft_data);
+    *CELL(COLUMN_IS_BEAT, int) = data->is_beat;
+    *CELL(COLUMN_BEATS, int) = data->beats;
+    *CELL(COLUMN_BPM, int) = data->bpm;
+
+    size_t band_size = (size_t)data->num_bands * sizeof(float);
+    memcpy(CELL(COLUMN_BAND_ACCUMULATED, float), band_values_of_gpu_data(data, BAND_ACCUMULATED), band_size);
+    memcpy(CELL(COLUMN_BAND_WINDOW, float), band_values_of_gpu_data(data, BAND_WINDOW), band_size);
+    memcpy(CELL(COLUMN_BAND_SMOOTH_WINDOW, float), band_values_of_gpu_data(data, BAND_SMOOTH_WINDOW), band_size);
+    memcpy(CELL(COLUMN_BAND_DELTA2, float), band_values_of_gpu_data(data, BAND_DELTA2), band_size);
+    memcpy(CELL(COLUMN_BAND_MOVEMENT, float), band_values_of_gpu_data(data, BAND_MOVEMENT), band_size);
+
+    FORI(0, num_beat_frequencies_of_analysis(analysis)) {
+        struct BeatState beat = beat_state_of_analysis(analysis, i);
+        CELL(COLUMN_BEAT_HZ, int)[i] = beat.hz;
+        CELL(COLUMN_BEAT_NOISE_THRESHOLD, float)[i] = beat.noise_threshold;
+        CELL(COLUMN_BEAT_SHORT_AVERAGE, float)[i] = beat.short_average;
+        CELL(COLUMN_BEAT_THRESHOLD, float)[i] = beat.beat_threshold;
+        CELL(COLUMN_BEAT_CURRENT, float)[i] = beat.current;
+        CELL(COLUMN_BEAT_SD_THRESHOLD, float)[i] = beat.sd_threshold;
+        CELL(COLUMN_BEAT_IS_BEAT, int)[i] = beat.is_beat;
+    }
+
+    *CELL(COLUMN_FEATURE_FLUX, float) = data->features.flux;
+    *CELL(COLUMN_FEATURE_CENTROID, float) = data->features.centroid;
+    *CELL(COLUMN_FEATURE_SPREAD, float) = data->features.spread;
+    *CELL(COLUMN_FEATURE_ROLLOFF, float) = data->features.rolloff;
+    *CELL(COLUMN_FEATURE_FLATNESS, float) = data->features.flatness;
+    *CELL(COLUMN_FEATURE_CREST, float) = data->features.crest;
+    *CELL(COLUMN_TEMPO_BPM, float) = data->tempo.bpm;
+    *CELL(COLUMN_TEMPO_PHASE, float) = data->tempo.phase;
+    *CELL(COLUMN_TEMPO_CONFIDENCE, float) = data->tempo.confidence;
+    // Bit 0 for a tempo beat, bit `1 + i` for an onset of beat frequency `i`.
+    uint64_t event_bands = 0;
+    struct BeatEvent event;
+    while(pop_beat_event(beat_events, &event)) {
+        event_bands |= UINT64_C(1) << (event.band - BEAT_EVENT_TEMPO);
+    }
+    *CELL(COLUMN_BEAT_EVENTS, uint64_t) = event_bands;
+
+    if(spectra) {
+        size_t num_bins = (size_t)(size_of_dft(dft_data) / 2 + 1);
+        memcpy(CELL(COLUMN_MAGNITUDE, float), magnitudes_of_dft(dft_data), num_bins * sizeof(float));
+        size_t num_cqt_bins = (size_t)num_bins_of_cqt(cqt);
+        memcpy(CELL(COLUMN_CQT, float), magnitudes_of_cqt(cqt), num_cqt_bins * sizeof(float));
+        size_t num_bands = (size_t)num_bands_of_filterbank(filterbank);
+        memcpy(CELL(COLUMN_FILTERBANK, float), bands_of_filterbank(filterbank), num_bands * sizeof(float));
+    }
+#undef CELL
+}
+
+int main(int argc, char* argv[]) {
+    struct HeadlessOptions options = parse_headless_options(argc, argv);
+
+    PcmFile pcm_file = create_pcm_file(options.input_path, options.raw_format);
+    struct PcmFormat format = format_of_pcm_file(pcm_file);
+
+    Pcm pcm = create_pcm(4 * format.sample_rate, format, 0);
+    if(options.wisdom_path != NULL) {
+        load_dft_wisdom(options.wisdom_path);
+    }
+    DftData dft_data =
+        create_dft_data(options.dft_size, options.hop_size, format.sample_rate, false, options.planning, 0);
+    Cqt cqt = create_cqt(dft_data, options.cqt_bins_per_octave, 30.0f, options.planning, 0);
+    if(options.wisdom_path != NULL) {
+        save_dft_wisdom(options.wisdom_path);
+    }
+    Filterbank filterbank =
+        create_filterbank(dft_data, options.filterbank_bands, options.filterbank_scale, 30.0f, 16000.0f, 0);
+    BeatEvents beat_events = create_beat_events(64, 0);
+    Analysis analysis = create_analysis(dft_data, cqt, filterbank, beat_events, &options.band_layout, 0);
+
+    int num_beat_frequencies = num_beat_frequencies_of_analysis(analysis);
+    // The `beat_events` mask has a bit for each and one for the tempo.
+    if(num_beat_frequencies > 63) {
+        fprintf(stderr, "%d beat frequencies don't fit the beat_events column, 63 do\n", num_beat_frequencies);
+        exit(1);
+    }
+    int num_bins = options.dft_size / 2 + 1;
+    int num_bands = options.band_layout.num_bands;
+    struct ColumnSpec const specs[NUM_COLUMNS] = {
+        [COLUMN_SAMPLE_INDEX] = {"sample_index", COLUMN_TYPE_U64, 1},
+        [COLUMN_IS_BEAT] = {"is_beat", COLUMN_TYPE_I32, 1},
+        [COLUMN_BEATS] = {"beats", COLUMN_TYPE_I32, 1},
+        [COLUMN_BPM] = {"bpm", COLUMN_TYPE_I32, 1},
+        [COLUMN_BAND_ACCUMULATED] = {"band.accumulated", COLUMN_TYPE_F32, num_bands},
+        [COLUMN_BAND_WINDOW] = {"band.window", COLUMN_TYPE_F32, num_bands},
+        [COLUMN_BAND_SMOOTH_WINDOW] = {"band.smooth_window", COLUMN_TYPE_F32, num_bands},
+        [COLUMN_BAND_DELTA2] = {"band.delta2", COLUMN_TYPE_F32, num_bands},
+        [COLUMN_BAND_MOVEMENT] = {"band.movement", COLUMN_TYPE_F32, num_bands},
+        [COLUMN_BEAT_HZ] = {"beat.hz", COLUMN_TYPE_I32, num_beat_frequencies},
+        [COLUMN_BEAT_NOISE_THRESHOLD] = {"beat.noise_threshold", COLUMN_TYPE_F32, num_beat_frequencies},
+        [COLUMN_BEAT_SHORT_AVERAGE] = {"beat.short_average", COLUMN_TYPE_F32, num_beat_frequencies},
+        [COLUMN_BEAT_THRESHOLD] = {"beat.threshold", COLUMN_TYPE_F32, num_beat_frequencies},
+        [COLUMN_BEAT_CURRENT] = {"beat.current", COLUMN_TYPE_F32, num_beat_frequencies},
+        [COLUMN_BEAT_SD_THRESHOLD] = {"beat.sd_threshold", COLUMN_TYPE_F32, num_beat_frequencies},
+        [COLUMN_BEAT_IS_BEAT] = {"beat.is_beat", COLUMN_TYPE_I32, num_beat_frequencies},
+        [COLUMN_FEATURE_FLUX] = {"feature.flux", COLUMN_TYPE_F32, 1},
+        [COLUMN_FEATURE_CENTROID] = {"feature.centroid", COLUMN_TYPE_F32, 1},
+        [COLUMN_FEATURE_SPREAD] = {"feature.spread", COLUMN_TYPE_F32, 1},
+        [COLUMN_FEATURE_ROLLOFF] = {"feature.rolloff", COLUMN_TYPE_F32, 1},
+        [COLUMN_FEATURE_FLATNESS] = {"feature.flatness", COLUMN_TYPE_F32, 1},
+        [COLUMN_FEATURE_CREST] = {"feature.crest", COLUMN_TYPE_F32, 1},
+        [COLUMN_TEMPO_BPM] = {"tempo.bpm", COLUMN_TYPE_F32, 1},
+        [COLUMN_TEMPO_PHASE] = {"tempo.phase", COLUMN_TYPE_F32, 1},
+        [COLUMN_TEMPO_CONFIDENCE] = {"tempo.confidence", COLUMN_TYPE_F32, 1},
+        [COLUMN_BEAT_EVENTS] = {"beat_events", COLUMN_TYPE_U64, 1},
+        [COLUMN_MAGNITUDE] = {"magnitude", COLUMN_TYPE_F32, num_bins},
+        [COLUMN_CQT] = {"cqt", COLUMN_TYPE_F32, num_bins_of_cqt(cqt)},
+        [COLUMN_FILTERBANK] = {"filterbank", COLUMN_TYPE_F32, num_bands_of_filterbank(filterbank)},
+    };
+
+    uint64_t num_samples = num_samples_of_pcm_file(pcm_file);
+    uint64_t max_rows = (num_samples + (uint64_t)options.hop_size - 1) / (uint64_t)options.hop_size;
+    struct ColumnarHeader metadata = {
+        .sample_rate = (uint32_t)format.sample_rate,
+        .hop_size = (uint32_t)options.hop_size,
+        .dft_size = (uint32_t)options.dft_size,
+    };
+    // The spectra are the last columns, leave them out entirely without -s
+    int num_columns = options.spectra ? NUM_COLUMNS : COLUMN_MAGNITUDE;
+    Columnar columnar = create_columnar(options.output_path, specs, num_columns, max_rows, metadata);
+
+    double start = get_monotonic_seconds();
+    uint64_t row = 0;
+    while(row < max_rows && advance_pcm_file(pcm_file, pcm, options.hop_size) > 0) {
+        compute_dft_frames(pcm, dft_data);
+        while(row < max_rows && next_dft_frame(dft_data)) {
+            analyze_dft_frame(pcm, dft_data, analysis);
+            write_row(columnar, row, dft_data, cqt, filterbank, analysis, beat_events, options.spectra);
+            row++;
+        }
+    }
+    set_columnar_num_rows(columnar, row);
+    double elapsed = get_monotonic_seconds() - start;
+
+    double audio_seconds = (double)num_samples / (double)format.sample_rate;
+    fprintf(stderr, "Analysed %.1f s of audio in %.2f s (%.1fx real time), %lu rows\n", audio_seconds, elapsed,
+            audio_seconds / MAX(elapsed, 1e-9), (unsigned long)row);
+
+    delete_columnar(columnar);
+    delete_analysis(analysis);
+    delete_beat_events(beat_events);
+    delete_filterbank(filterbank);
+    delete_cqt(cqt);
+    delete_dft_data(dft_data);
+    delete_pcm(pcm);
+    delete_pcm_file(pcm_file);
+
+    return 0;
+}
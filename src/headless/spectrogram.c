@@ -0,0 +1,24 @@
+// There is no spectrogram texture in the headless build, rows are dropped.
+
+#include <stddef.h>
+
+#include "spectrogram.h"
+
+__attribute__((const)) Spectrogram create_spectrogram(DftData dft_data, int num_rows, unsigned int index,
+                                                      unsigned int texture_unit) {
+    (void)dft_data;
+    (void)num_rows;
+    (void)index;
+    (void)texture_unit;
+    return NULL;
+}
+
+void add_spectrogram_rows(Spectrogram spectrogram, DftData dft_data, int num_frames) {
+    (void)spectrogram;
+    (void)dft_data;
+    (void)num_frames;
+}
+
+void copy_spectrogram_to_gpu(Spectrogram spectrogram) { (void)spectrogram; }
+
+void delete_spectrogram(Spectrogram spectrogram) { (void)spectrogram; }
@@ -0,0 +1,63 @@
+#include <stdlib.h>
+
+#include "buffers.h"
+#include "globals.h"
+#include "interleave.h"
+
+// The quarter pattern alternates diagonals, every pixel of a 2x2 block gets
+// its turn and the fresh ones are never all on one side.
+static int const quarter_phases[4] = {0, 3, 1, 2};
+
+struct Interleave_ {
+    int factor;
+    int frame;
+
+    // Layout of the `interleave_data` block.
+    struct {
+        int factor;
+        int phase;
+    } data;
+    Buffer buffer;
+};
+
+Interleave create_interleave(int factor, unsigned int index) {
+    Interleave interleave = ALLOCATE(1, struct Interleave_);
+    interleave->factor = factor;
+    interleave->frame = 0;
+
+    interleave->data.factor = factor;
+    interleave->data.phase = 0;
+    interleave->buffer = create_streaming_uniform_buffer(isizeof(interleave->data), index);
+    copy_buffer_to_gpu(interleave->buffer, &interleave->data, 0, isizeof(interleave->data));
+    commit_buffer_to_gpu(interleave->buffer);
+
+    return interleave;
+}
+
+void advance_interleave(Interleave interleave) {
+    if(interleave->factor == 1) {
+        return;
+    }
+    interleave->frame = (interleave->frame + 1) % interleave->factor;
+    interleave->data.phase = interleave->factor == 4 ? quarter_phases[interleave->frame] : interleave->frame;
+    copy_buffer_to_gpu(interleave->buffer, &interleave->data.phase, isizeof(int), isizeof(int));
+    commit_buffer_to_gpu(interleave->buffer);
+}
+
+__attribute__((pure)) int phase_of_interleave(Interleave interleave) { return interleave->data.phase; }
+
+__attribute__((pure)) struct Size dispatch_size_of_interleave(Interleave interleave, struct Size size) {
+    switch(interleave->factor) {
+    case 2:
+        return (struct Size){.w = (size.w + 1) / 2, .h = size.h};
+    case 4:
+        return (struct Size){.w = (size.w + 1) / 2, .h = (size.h + 1) / 2};
+    default:
+        return size;
+    }
+}
+
+void delete_interleave(Interleave interleave) {
+    delete_buffer(interleave->buffer);
+    free(interleave);
+}
@@ -8,14 +8,23 @@
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
 
+#include "beat_events.h"
 #include "buffers.h"
+#include "cqt.h"
 #include "globals.h"
+#include "governor.h"
+#include "interleave.h"
 #include "dft.h"
+#include "filterbank.h"
 #include "pcm.h"
+#include "pcm_file.h"
+#include "pipeline.h"
 #include "analysis.h"
+#include "options.h"
 #include "program.h"
 #include "random.h"
 #include "sdl.h"
+#include "spectrogram.h"
 #include "textures.h"
 #include "timer.h"
 #include "window.h"
@@ -36,7 +45,7 @@ UserInput create_user_input(void) {
 
 void delete_user_input(UserInput user_input) { free(user_input); }
 
-void handle_events(UserInput user_input, Random random, Textures textures, struct Size* size) {
+void handle_events(UserInput user_input, Random random, struct Size* size) {
     SDL_Event event;
     while(SDL_PollEvent(&event)) {
         switch(event.type) {
@@ -52,8 +61,8 @@ void handle_events(UserInput user_input, Random random, Textures textures, struc
             if(event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
                 *size = (struct Size){.w = event.window.data1, .h = event.window.data2};
 
+                // The textures follow the render size in the main loop.
                 update_random_window_size(random, *size);
-                update_textures_window_size(textures, *size);
             }
             break;
 
@@ -63,51 +72,156 @@ void handle_events(UserInput user_input, Random random, Textures textures, struc
     }
 }
 
+// False if the programs declare an image in different formats.
+bool image_formats_of_programs(Program basic, Program reconstruct, struct ImageFormats* image_formats) {
+    *image_formats = (struct ImageFormats){0};
+    bool consistent = add_program_image_formats(basic, image_formats);
+    if(reconstruct != NULL) {
+        consistent = add_program_image_formats(reconstruct, image_formats) && consistent;
+    }
+    return consistent;
+}
+
 int main(int argc, char* argv[]) {
-    (void)argc;
-    (void)argv;
+    struct Options options = parse_options(argc, argv);
+
+    // A file brings its own format.
+    PcmFile pcm_file = NULL;
+    struct PcmFormat pcm_format = options.pcm_format;
+    if(options.input_path != NULL) {
+        pcm_file = create_pcm_file(options.input_path, options.pcm_format);
+        pcm_format = format_of_pcm_file(pcm_file);
+    }
+    int sample_rate = pcm_format.sample_rate;
 
     create_sdl();
 
     struct Size size = {.w = 800, .h = 800};
     Window window = create_window(size);
-    Textures textures = create_textures(size);
-
-    Program basic = create_program("assets/shaders/ray_march.comp");
-    /* Program basic_present = create_program("assets/shaders/num2_present.comp"); */
 
     Timer timer = create_timer(1);
+    Interleave interleave = create_interleave(options.interleave, 3);
     Random random = create_random(size, 2);
-    Pcm pcm = create_pcm(4 * 44100, 3);
-    PcmStream pcm_stream = create_pcm_stream(pcm);
-    DftData dft_data = create_dft_data(4096, 4);
-    Analysis analysis = create_analysis(pcm, dft_data, 5);
+    Pcm pcm = create_pcm(4 * sample_rate, pcm_format, 3);
+    PcmStream pcm_stream = pcm_file == NULL ? create_pcm_stream(pcm) : NULL;
+    if(options.wisdom_path != NULL && load_dft_wisdom(options.wisdom_path)) {
+        printf("Loaded FFTW wisdom from %s\n", options.wisdom_path);
+    }
+    DftData dft_data = create_dft_data(4096, options.hop_size, sample_rate, options.stereo, options.planning, 4);
+    Spectrogram spectrogram = create_spectrogram(dft_data, 512, 2, 1);
+    Cqt cqt = create_cqt(dft_data, options.cqt_bins_per_octave, 30.0f, options.planning, 6);
+    Filterbank filterbank =
+        create_filterbank(dft_data, options.filterbank_bands, options.filterbank_scale, 30.0f, 16000.0f, 7);
+    BeatEvents beat_events = create_beat_events(64, 8);
+    Analysis analysis = create_analysis(dft_data, cqt, filterbank, beat_events, &options.band_layout, 5);
+    // The shaders get `analysis_data` declared for the configured bands.
+    char* analysis_glsl = glsl_of_analysis(analysis);
+    Program basic = create_program("assets/shaders/ray_march.comp", analysis_glsl);
+    /* Program basic_present = create_program("assets/shaders/num2_present.comp", analysis_glsl); */
+    // Fills in the pixels an interleaved frame skipped.
+    Program reconstruct = options.interleave > 1 ? create_program("assets/shaders/reconstruct.comp", "") : NULL;
+    // Only the images the programs use get allocated, in the formats they declare.
+    struct ImageFormats image_formats;
+    if(!image_formats_of_programs(basic, reconstruct, &image_formats)) {
+        fprintf(stderr, "The shaders don't agree on the image formats\n");
+        exit(1);
+    }
+    // Heavy shaders render below the window resolution when they would drop frames.
+    Governor governor = create_governor(options.frame_budget_s, options.render_scale, options.stats);
+    struct Size render_size = render_size_of_governor(governor, size);
+    Textures textures = create_textures(render_size, &image_formats);
+    // All plans exist now, save right away instead of on exit, kiosks tend to be switched off.
+    if(options.wisdom_path != NULL) {
+        save_dft_wisdom(options.wisdom_path);
+    }
+    // Live input is analysed on its own thread as it arrives, offline mode stays in step with the frames.
+    Pipeline pipeline = options.offline ? NULL
+                                        : create_pipeline(pcm, dft_data, cqt, filterbank, analysis, spectrogram,
+                                                          options.wake_samples, options.stats);
     UserInput user_input = create_user_input();
 
+    // In offline mode, analyse hops for this long before showing a frame.
+    double const offline_frame_s = 0.016;
+
     int cycles = 0;
     float s_per_frame = 0.016f; // 60 FPS?
     time_t last = clock();
 
     while(!user_input->quit_requested) {
-        reinstall_program_if_modified(basic);
-        /* reinstall_program_if_modified(basic_present); */
+        bool basic_reinstalled = reinstall_program_if_modified(basic);
+        /* reinstalled |= reinstall_program_if_modified(basic_present); */
+        bool reconstruct_reinstalled = reconstruct != NULL && reinstall_program_if_modified(reconstruct);
+        if(basic_reinstalled || reconstruct_reinstalled) {
+            struct ImageFormats new_image_formats;
+            if(image_formats_of_programs(basic, reconstruct, &new_image_formats)) {
+                image_formats = new_image_formats;
+                update_texture_formats(textures, &image_formats);
+            } else {
+                // Like a shader that doesn't compile, keep running the previous ones.
+                fprintf(stderr, "Keeping the previous shaders\n");
+                if(basic_reinstalled) {
+                    restore_previous_program(basic);
+                }
+                if(reconstruct_reinstalled) {
+                    restore_previous_program(reconstruct);
+                }
+            }
+        }
 
         // Copy data.
         copy_timer_to_gpu(timer);
+        advance_interleave(interleave);
+
+        if(options.offline) {
+            // Feed the file a hop at a time, only the last result gets uploaded.
+            double frame_start = get_monotonic_seconds();
+            while(!pcm_file_finished(pcm_file) && get_monotonic_seconds() - frame_start < offline_frame_s) {
+                advance_pcm_file(pcm_file, pcm, options.hop_size);
+                int num_frames = compute_dft_frames(pcm, dft_data);
+                add_spectrogram_rows(spectrogram, dft_data, num_frames);
+                while(next_dft_frame(dft_data)) {
+                    analyze_dft_frame(pcm, dft_data, analysis);
+                }
+            }
+            copy_dft_data_to_gpu(dft_data);
+            copy_spectrogram_to_gpu(spectrogram);
+            copy_analysis_to_gpu(analysis);
+            copy_cqt_to_gpu(cqt);
+            copy_filterbank_to_gpu(filterbank);
+        } else {
+            if(pcm_file != NULL) {
+                play_pcm_file(pcm_file, pcm);
+            }
+            copy_pipeline_to_gpu(pipeline);
+        }
         copy_pcm_to_gpu(pcm);
-        compute_and_copy_dft_data_to_gpu(pcm, dft_data);
-        compute_and_copy_analysis_to_gpu(dft_data, analysis);
+        copy_beat_events_to_gpu(beat_events, pcm_sample_index(pcm));
 
         // Render and display.
         // Prepare for next frame.
         swap_and_bind_textures(textures);
         // Render the next frame to the back texture.
-        run_program(basic, (GLuint)size.w, (GLuint)size.h);
-        /* run_program(basic_present, (GLuint)size.w, (GLuint)size.h); */
-        display_texture(window, get_present_texture(textures), size);
+        begin_governed_frame(governor);
+        // Shaders that don't know about interleaving render every pixel.
+        if(reconstruct != NULL && program_uses_uniform_block(basic, "interleave_data")) {
+            struct Size dispatch_size = dispatch_size_of_interleave(interleave, render_size);
+            run_program(basic, (GLuint)dispatch_size.w, (GLuint)dispatch_size.h);
+            run_program(reconstruct, (GLuint)dispatch_size.w, (GLuint)dispatch_size.h);
+        } else {
+            run_program(basic, (GLuint)render_size.w, (GLuint)render_size.h);
+        }
+        /* run_program(basic_present, (GLuint)render_size.w, (GLuint)render_size.h); */
+        end_governed_frame(governor);
+        display_texture(window, get_present_texture(textures), render_size, size);
 
         // Events.
-        handle_events(user_input, random, textures, &size);
+        handle_events(user_input, random, &size);
+        // A resized window or a new render scale.
+        struct Size new_render_size = render_size_of_governor(governor, size);
+        if(new_render_size.w != render_size.w || new_render_size.h != render_size.h) {
+            render_size = new_render_size;
+            update_textures_window_size(textures, render_size);
+        }
 
         time_t c = clock();
         float delta = (float)(c - last) / (float)CLOCKS_PER_SEC;
@@ -119,18 +233,40 @@ int main(int argc, char* argv[]) {
         /* } */
 
         cycles++;
+
+        if(pcm_file != NULL && pcm_file_finished(pcm_file)) {
+            user_input->quit_requested = true;
+        }
     }
 
     delete_user_input(user_input);
+    if(pipeline != NULL) {
+        delete_pipeline(pipeline);
+    }
     delete_analysis(analysis);
+    delete_beat_events(beat_events);
+    delete_filterbank(filterbank);
+    delete_cqt(cqt);
+    delete_spectrogram(spectrogram);
     delete_dft_data(dft_data);
-    delete_pcm_stream(pcm_stream);
+    if(pcm_stream != NULL) {
+        delete_pcm_stream(pcm_stream);
+    }
     delete_pcm(pcm);
+    if(pcm_file != NULL) {
+        delete_pcm_file(pcm_file);
+    }
     delete_random(random);
+    delete_interleave(interleave);
     delete_timer(timer);
     /* delete_program(basic_present); */
+    if(reconstruct != NULL) {
+        delete_program(reconstruct);
+    }
     delete_program(basic);
+    free(analysis_glsl);
     delete_textures(textures);
+    delete_governor(governor);
     delete_window(window);
     delete_sdl();
 
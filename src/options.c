@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "globals.h"
+#include "options.h"
+
+static struct {
+    char const* name;
+    enum SampleFormat format;
+} const sample_format_names[] = {
+    {"u8", SAMPLE_FORMAT_U8},       {"s16le", SAMPLE_FORMAT_S16LE}, {"s24le", SAMPLE_FORMAT_S24LE},
+    {"s32le", SAMPLE_FORMAT_S32LE}, {"f32le", SAMPLE_FORMAT_F32LE}, {"float32le", SAMPLE_FORMAT_F32LE},
+};
+
+static char const* const planning_names[] = {
+    [DFT_PLANNING_ESTIMATE] = "estimate",
+    [DFT_PLANNING_MEASURE] = "measure",
+    [DFT_PLANNING_PATIENT] = "patient",
+    [DFT_PLANNING_EXHAUSTIVE] = "exhaustive",
+};
+
+static char const* const filterbank_scale_names[] = {
+    [FILTERBANK_MEL] = "mel",
+    [FILTERBANK_LOG] = "log",
+    [FILTERBANK_BARK] = "bark",
+};
+
+void print_usage(char const* program_name) {
+    fprintf(stderr, "Usage: %s [OPTION]...\n", program_name);
+    fprintf(stderr, "Visualize raw PCM data read from stdin or a file.\n\n");
+    fprintf(stderr, "  -i, --input=FILE       read a WAV, AU or raw PCM file instead of stdin\n");
+    fprintf(stderr, "  -o, --offline          analyse the input file as fast as possible\n");
+    fprintf(stderr, "  -H, --hop=SAMPLES      samples between DFT frames (default 512)\n");
+    fprintf(stderr, "  -f, --format=FORMAT    raw sample format: u8, s16le, s24le, s32le, f32le (default f32le)\n");
+    fprintf(stderr, "  -c, --channels=N       number of interleaved channels, 1 to 8 (default 2)\n");
+    fprintf(stderr, "  -r, --rate=HZ          sample rate (default 44100)\n");
+    fprintf(stderr, "  -w, --wake=SAMPLES     new samples to wait for per frame (default 512)\n");
+    fprintf(stderr, "  -S, --stereo           separate left/right/mid/side spectra for the shaders\n");
+    fprintf(stderr, "  -Q, --cqt-bins=N       constant-Q bins per octave, 6 to 96 (default 24)\n");
+    fprintf(stderr, "  -B, --bands=N          filterbank bands for the shaders, 1 to 1024 (default 64)\n");
+    fprintf(stderr, "  -F, --filterbank=SCALE filterbank spacing: mel, log, bark (default mel)\n");
+    fprintf(stderr, "  -e, --band-edges=LIST  comma separated band edges in Hz, or a band count up to 64\n");
+    fprintf(stderr, "  -P, --planning=LEVEL   FFTW planning: estimate, measure, patient, exhaustive (default measure)\n");
+    fprintf(stderr, "  -W, --wisdom=FILE      FFTW wisdom cache, empty to disable (default ~/.cache/...)\n");
+    fprintf(stderr, "  -b, --frame-budget=MS  lower the resolution above this GPU time, 0 to keep it (default 12)\n");
+    fprintf(stderr, "  -R, --render-scale=X   render resolution relative to the window, 0.25 to 2 (default 1)\n");
+    fprintf(stderr, "  -I, --interleave=N     render every Nth pixel per frame, 1, 2 or 4 (default 1)\n");
+    fprintf(stderr, "  -s, --stats            print the thread timings and render scale every few seconds\n");
+    fprintf(stderr, "  -h, --help             show this help\n");
+}
+
+__attribute__((noreturn)) void fail_with_usage(char const* program_name, char const* message, char const* value) {
+    fprintf(stderr, "%s: %s '%s'\n\n", program_name, message, value);
+    print_usage(program_name);
+    exit(1);
+}
+
+int parse_int_option(char const* program_name, char const* value, int min, int max,
+                     void (*print_program_usage)(char const* program_name)) {
+    char* end;
+    long number = strtol(value, &end, 10);
+    if(*value == '\0' || *end != '\0' || number < min || number > max) {
+        fprintf(stderr, "%s: invalid number '%s', expected %d to %d\n\n", program_name, value, min, max);
+        print_program_usage(program_name);
+        exit(1);
+    }
+    return (int)number;
+}
+
+double parse_double_option(char const* program_name, char const* value, double min, double max) {
+    char* end;
+    double number = strtod(value, &end);
+    if(*value == '\0' || *end != '\0' || !(number >= min && number <= max)) {
+        fail_with_usage(program_name, "invalid number", value);
+    }
+    return number;
+}
+
+bool parse_sample_format(char const* value, enum SampleFormat* format) {
+    int num_names = isizeof(sample_format_names) / isizeof(sample_format_names[0]);
+    FORI(0, num_names) {
+        if(strcmp(sample_format_names[i].name, value) == 0) {
+            *format = sample_format_names[i].format;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_dft_planning(char const* value, enum DftPlanning* planning) {
+    int num_names = isizeof(planning_names) / isizeof(planning_names[0]);
+    FORI(0, num_names) {
+        if(strcmp(planning_names[i], value) == 0) {
+            *planning = (enum DftPlanning)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+char const* default_wisdom_path(void) {
+    // Wisdom only holds for the machine that measured it, hence the host name.
+    static char path[1024];
+    char host[256] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+
+    char const* cache = getenv("XDG_CACHE_HOME");
+    char const* home = getenv("HOME");
+    if(cache != NULL && cache[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/oscilloscope-visualizer/fftwf-wisdom-%s", cache, host);
+    } else if(home != NULL && home[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/.cache/oscilloscope-visualizer/fftwf-wisdom-%s", home, host);
+    } else {
+        return NULL;
+    }
+    return path;
+}
+
+bool parse_band_edges(char const* value, struct BandLayout* layout) {
+    if(strchr(value, ',') == NULL) {
+        // A count, spread the bands evenly on a log scale over the default range.
+        char* end;
+        long num_bands = strtol(value, &end, 10);
+        if(*value == '\0' || *end != '\0' || num_bands < 1 || num_bands > MAX_BANDS) {
+            return false;
+        }
+        struct BandLayout defaults = default_band_layout();
+        float low = defaults.edges_hz[0];
+        float high = defaults.edges_hz[defaults.num_bands];
+        layout->num_bands = (int)num_bands;
+        FORI(0, layout->num_bands + 1) {
+            layout->edges_hz[i] = low * powf(high / low, (float)i / (float)num_bands);
+        }
+        return true;
+    }
+
+    int num_edges = 0;
+    char const* edge = value;
+    while(true) {
+        char* end;
+        float hz = strtof(edge, &end);
+        bool is_increasing = num_edges == 0 || hz > layout->edges_hz[num_edges - 1];
+        if(end == edge || !(hz > 0.0f) || !is_increasing || num_edges == MAX_BANDS + 1) {
+            return false;
+        }
+        layout->edges_hz[num_edges++] = hz;
+        if(*end == '\0') {
+            break;
+        }
+        if(*end != ',') {
+            return false;
+        }
+        edge = end + 1;
+    }
+    layout->num_bands = num_edges - 1;
+    return num_edges >= 2;
+}
+
+bool parse_filterbank_scale(char const* value, enum FilterbankScale* scale) {
+    int num_names = isizeof(filterbank_scale_names) / isizeof(filterbank_scale_names[0]);
+    FORI(0, num_names) {
+        if(strcmp(filterbank_scale_names[i], value) == 0) {
+            *scale = (enum FilterbankScale)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Options parse_options(int argc, char* argv[]) {
+    struct Options options = {
+        .pcm_format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = 44100},
+        .input_path = NULL,
+        .offline = false,
+        .hop_size = 512,
+        .wake_samples = 512,
+        .stereo = false,
+        .cqt_bins_per_octave = 24,
+        .filterbank_bands = 64,
+        .filterbank_scale = FILTERBANK_MEL,
+        .band_layout = default_band_layout(),
+        .planning = DFT_PLANNING_MEASURE,
+        .wisdom_path = default_wisdom_path(),
+        .frame_budget_s = 0.012,
+        .render_scale = 1.0f,
+        .interleave = 1,
+        .stats = false,
+    };
+
+    struct option const long_options[] = {
+        {"format", required_argument, NULL, 'f'},     {"channels", required_argument, NULL, 'c'},
+        {"rate", required_argument, NULL, 'r'},       {"wake", required_argument, NULL, 'w'},
+        {"input", required_argument, NULL, 'i'},      {"offline", no_argument, NULL, 'o'},
+        {"hop", required_argument, NULL, 'H'},        {"planning", required_argument, NULL, 'P'},
+        {"wisdom", required_argument, NULL, 'W'},     {"stereo", no_argument, NULL, 'S'},
+        {"cqt-bins", required_argument, NULL, 'Q'},   {"bands", required_argument, NULL, 'B'},
+        {"filterbank", required_argument, NULL, 'F'}, {"band-edges", required_argument, NULL, 'e'},
+        {"frame-budget", required_argument, NULL, 'b'}, {"render-scale", required_argument, NULL, 'R'},
+        {"interleave", required_argument, NULL, 'I'}, {"stats", no_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    char const* program_name = argv[0];
+    int option;
+    while((option = getopt_long(argc, argv, "f:c:r:w:i:oH:SQ:B:F:e:P:W:b:R:I:sh", long_options, NULL)) != -1) {
+        switch(option) {
+        case 'f':
+            if(!parse_sample_format(optarg, &options.pcm_format.sample_format)) {
+                fail_with_usage(program_name, "unknown sample format", optarg);
+            }
+            break;
+        case 'c':
+            options.pcm_format.channels = parse_int_option(program_name, optarg, 1, 8, print_usage);
+            break;
+        case 'r':
+            options.pcm_format.sample_rate = parse_int_option(program_name, optarg, 1000, 768000, print_usage);
+            break;
+        case 'w':
+            options.wake_samples = parse_int_option(program_name, optarg, 1, 1 << 20, print_usage);
+            break;
+        case 'i':
+            options.input_path = optarg;
+            break;
+        case 'o':
+            options.offline = true;
+            break;
+        case 'H':
+            options.hop_size = parse_int_option(program_name, optarg, 1, 1 << 20, print_usage);
+            break;
+        case 'S':
+            options.stereo = true;
+            break;
+        case 'Q':
+            options.cqt_bins_per_octave = parse_int_option(program_name, optarg, 6, 96, print_usage);
+            break;
+        case 'B':
+            options.filterbank_bands = parse_int_option(program_name, optarg, 1, 1024, print_usage);
+            break;
+        case 'F':
+            if(!parse_filterbank_scale(optarg, &options.filterbank_scale)) {
+                fail_with_usage(program_name, "unknown filterbank scale", optarg);
+            }
+            break;
+        case 'e':
+            if(!parse_band_edges(optarg, &options.band_layout)) {
+                fail_with_usage(program_name, "invalid band edges", optarg);
+            }
+            break;
+        case 'P':
+            if(!parse_dft_planning(optarg, &options.planning)) {
+                fail_with_usage(program_name, "unknown planning level", optarg);
+            }
+            break;
+        case 'W':
+            options.wisdom_path = optarg[0] == '\0' ? NULL : optarg;
+            break;
+        case 'b':
+            options.frame_budget_s = parse_double_option(program_name, optarg, 0.0, 1000.0) / 1000.0;
+            break;
+        case 'R':
+            options.render_scale = (float)parse_double_option(program_name, optarg, 0.25, 2.0);
+            break;
+        case 'I':
+            options.interleave = parse_int_option(program_name, optarg, 1, 4, print_usage);
+            if(options.interleave == 3) {
+                fail_with_usage(program_name, "interleave factor has to be 1, 2 or 4, got", optarg);
+            }
+            break;
+        case 's':
+            options.stats = true;
+            break;
+        case 'h':
+            print_usage(program_name);
+            exit(0);
+        default:
+            print_usage(program_name);
+            exit(1);
+        }
+    }
+
+    if(optind < argc) {
+        fail_with_usage(program_name, "unexpected argument", argv[optind]);
+    }
+
+    if(options.offline && options.input_path == NULL) {
+        fail_with_usage(program_name, "offline mode needs an input file, got", "stdin");
+    }
+
+    return options;
+}
@@ -1,9 +1,16 @@
-#include <fcntl.h>
+// Required for poll, clock_gettime and pthread_condattr_setclock.
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <poll.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include<assert.h>
 
@@ -13,150 +20,315 @@
 #include "buffers.h"
 #include "globals.h"
 #include "pcm.h"
-
+#include "ring_buffer.h"
+#include "simd.h"
+
+// Single producer (the ingest thread), single consumer (the analysis thread).
+// `copy_pcm_to_gpu` only reads published samples and may run on a third one.
+//
+// The producer first claims the range it is about to overwrite, then writes
+// the samples and finally publishes the new `sample_index` with release
+// semantics. The consumer reads `sample_index` with acquire semantics, copies
+// what it needs and checks the claim afterwards to detect whether the producer
+// lapped it during the copy (seqlock style). The producer never waits.
+//
+// A consumer that wants to sleep until enough new samples have arrived
+// registers the index it is waiting for in `wake_index`. The producer only
+// touches the mutex when a published index reaches it.
 struct Pcm_ {
+    struct PcmFormat format;
     int num_samples;
 
-    int sample_index;
-    float* ring_left;
-    float* ring_right;
-    int offset;
-
+    // Absolute index of the next sample to be written, i.e. the ring offset is
+    // `sample_index % num_samples`. Both are only ever written by the producer.
+    _Atomic uint64_t sample_index;
+    _Atomic uint64_t claimed_index;
+    // Mirrored mappings, any window of up to `num_samples` is contiguous.
+    RingBuffer ring_left;
+    RingBuffer ring_right;
+
+    // Consumer side bookkeeping.
+    uint64_t read_index;
+    struct PcmStats stats;
+
+    _Atomic uint64_t wake_index;
+    pthread_mutex_t wake_mutex;
+    pthread_cond_t wake_condition;
+
+    // The GPU ring has the same layout as ours. Render thread side, samples
+    // before `gpu_index` are on the GPU.
+    uint64_t gpu_index;
     Buffer buffer;
 };
 
-Pcm create_pcm(int num_samples, unsigned int index) {
+__attribute__((pure)) float* ring_at(RingBuffer ring, uint64_t sample_index) {
+    return (float*)ring_buffer_at(ring, sample_index * sizeof(float));
+}
+
+// Uploads ring positions `[first, first + num_samples)` of both channels, they must not wrap.
+void copy_pcm_ring_to_gpu(Pcm pcm, int first, int num_samples) {
+    int offset = 4 * isizeof(int) + first * isizeof(float);
+    int size = num_samples * isizeof(float);
+    copy_buffer_to_gpu(pcm->buffer, ring_at(pcm->ring_left, (uint64_t)first), offset, size);
+    copy_buffer_to_gpu(pcm->buffer, ring_at(pcm->ring_right, (uint64_t)first),
+                       offset + pcm->num_samples * isizeof(float), size);
+}
+
+Pcm create_pcm(int num_samples, struct PcmFormat format, unsigned int index) {
     Pcm pcm = (struct Pcm_*)malloc(sizeof(struct Pcm_));
+    pcm->format = format;
+    atomic_init(&pcm->sample_index, 0);
+    atomic_init(&pcm->claimed_index, 0);
+    // The rings are page aligned, so there may be room for a few more samples.
+    // They start out zeroed.
+    pcm->ring_left = create_ring_buffer(num_samples * isizeof(float));
+    pcm->ring_right = create_ring_buffer(num_samples * isizeof(float));
+    num_samples = size_of_ring_buffer(pcm->ring_left) / isizeof(float);
     pcm->num_samples = num_samples;
-    pcm->sample_index = 0;
-    pcm->ring_left = malloc((size_t)num_samples * sizeof(float));
-    pcm->ring_right = malloc((size_t)num_samples * sizeof(float));
-    pcm->offset = 0;
-
-    for(int i = 0; i < num_samples; i++) {
-        pcm->ring_left[i] = 0.0f;
-        pcm->ring_right[i] = 0.0f;
-    }
 
-    int gpu_buffer_size = 3 * isizeof(int) + 2 * num_samples * isizeof(float);
-    pcm->buffer = create_storage_buffer(gpu_buffer_size, index);
+    pcm->read_index = 0;
+    pcm->stats = (struct PcmStats){.xruns = 0, .dropped_samples = 0, .torn_reads = 0};
+
+    atomic_init(&pcm->wake_index, UINT64_MAX);
+    pthread_mutex_init(&pcm->wake_mutex, NULL);
+    pthread_condattr_t condition_attributes;
+    pthread_condattr_init(&condition_attributes);
+    pthread_condattr_setclock(&condition_attributes, CLOCK_MONOTONIC);
+    pthread_cond_init(&pcm->wake_condition, &condition_attributes);
+    pthread_condattr_destroy(&condition_attributes);
+
+    int gpu_buffer_size = 4 * isizeof(int) + 2 * num_samples * isizeof(float);
+    pcm->buffer = create_streaming_storage_buffer(gpu_buffer_size, index);
     copy_buffer_to_gpu(pcm->buffer, &num_samples, 0, sizeof(int));
+    copy_buffer_to_gpu(pcm->buffer, &format.sample_rate, 2 * isizeof(int), sizeof(int));
+    // Zeroes like the rings, from here on only new samples go up.
+    copy_pcm_ring_to_gpu(pcm, 0, num_samples);
+    pcm->gpu_index = 0;
+    commit_buffer_to_gpu(pcm->buffer);
 
     return pcm;
 }
 
-__attribute__((const)) int sample_rate_of_pcm(Pcm pcm) {
-    (void)pcm;
-    // I just assume 44100???
-    return 44100;
+__attribute__((pure)) int sample_rate_of_pcm(Pcm pcm) { return pcm->format.sample_rate; }
+
+__attribute__((pure)) struct PcmFormat format_of_pcm(Pcm pcm) { return pcm->format; }
+
+void write_pcm_samples(Pcm pcm, float const* interleaved, int num_samples) {
+    // Only the last `pcm->num_samples` samples can survive anyway.
+    int skipped = MAX(0, num_samples - pcm->num_samples);
+    interleaved += pcm->format.channels * skipped;
+
+    uint64_t start = atomic_load_explicit(&pcm->sample_index, memory_order_relaxed);
+    uint64_t end = start + (uint64_t)num_samples;
+    start += (uint64_t)skipped;
+
+    // Announce the overwrite before touching the ring.
+    atomic_store_explicit(&pcm->claimed_index, end, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    float* left = ring_at(pcm->ring_left, start);
+    float* right = ring_at(pcm->ring_right, start);
+    deinterleave_channels(interleaved, pcm->format.channels, left, right, (int)(end - start));
+
+    atomic_store_explicit(&pcm->sample_index, end, memory_order_release);
+
+    // Pairs with the fence in `wait_for_pcm_samples`: either the waiter sees
+    // the new index or we see its wake index.
+    atomic_thread_fence(memory_order_seq_cst);
+    if(end >= atomic_load_explicit(&pcm->wake_index, memory_order_relaxed)) {
+        pthread_mutex_lock(&pcm->wake_mutex);
+        pthread_cond_broadcast(&pcm->wake_condition);
+        pthread_mutex_unlock(&pcm->wake_mutex);
+    }
 }
 
-void copy_pcm_to_gpu(Pcm pcm) {
-    int sample_index = pcm->sample_index;
-    int offset = pcm->offset;
+uint64_t pcm_sample_index(Pcm pcm) { return atomic_load_explicit(&pcm->sample_index, memory_order_acquire); }
+
+bool wait_for_pcm_samples(Pcm pcm, int num_samples, int timeout_ms) {
+    uint64_t target = pcm->read_index + (uint64_t)num_samples;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    long deadline_ns = deadline.tv_nsec + (long)timeout_ms * 1000000L;
+    deadline.tv_sec += deadline_ns / 1000000000L;
+    deadline.tv_nsec = deadline_ns % 1000000000L;
 
-    char* left = (char*)pcm->ring_left;
-    char* right = (char*)pcm->ring_right;
-    int pcm_size = pcm->num_samples * isizeof(float);
-    int pcm_wrap_offset = offset * isizeof(float);
+    pthread_mutex_lock(&pcm->wake_mutex);
+    atomic_store_explicit(&pcm->wake_index, target, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
 
-    copy_buffer_to_gpu(pcm->buffer, (char*)&sample_index, sizeof(int), sizeof(int));
+    bool is_available = atomic_load_explicit(&pcm->sample_index, memory_order_relaxed) >= target;
+    int res = 0;
+    while(!is_available && res != ETIMEDOUT) {
+        res = pthread_cond_timedwait(&pcm->wake_condition, &pcm->wake_mutex, &deadline);
+        is_available = atomic_load_explicit(&pcm->sample_index, memory_order_relaxed) >= target;
+    }
+
+    atomic_store_explicit(&pcm->wake_index, UINT64_MAX, memory_order_relaxed);
+    pthread_mutex_unlock(&pcm->wake_mutex);
 
-    copy_ringbuffer_to_gpu(pcm->buffer, left, 2 * isizeof(int), pcm_size, pcm_wrap_offset);
-    copy_ringbuffer_to_gpu(pcm->buffer, right, 2 * isizeof(int) + pcm_size, pcm_size, pcm_wrap_offset);
+    return is_available;
 }
 
-void copy_pcm_mono_to_buffer(float* dst, Pcm pcm, int num_floats) {
-    int offset = pcm->offset;
+struct PcmWindow consume_pcm(Pcm pcm) {
+    uint64_t end = pcm_sample_index(pcm);
+    uint64_t start = pcm->read_index;
 
-    int floats_to_start = MIN(offset, num_floats);
-    int floats_from_end = num_floats - floats_to_start;
-    assert(floats_to_start + floats_from_end == num_floats);
+    uint64_t ring_size = (uint64_t)pcm->num_samples;
+    if(end - start > ring_size) {
+        pcm->stats.xruns++;
+        pcm->stats.dropped_samples += end - start - ring_size;
+        start = end - ring_size;
+    }
 
-    int num_samples = pcm->num_samples;
-    bool modulo_index_matches = (num_samples + offset - num_floats) % num_samples == num_samples - floats_from_end;
-    assert(modulo_index_matches || floats_from_end == 0);
+    pcm->read_index = end;
+    return (struct PcmWindow){.start = start, .end = end};
+}
+
+bool copy_pcm_window(Pcm pcm, uint64_t end, int num_samples, float* left, float* right) {
+    assert(num_samples <= pcm->num_samples);
+    // Samples before the start of the stream are silence.
+    int num_copied = (int)MIN(end, (uint64_t)num_samples);
+    int silent = num_samples - num_copied;
+    uint64_t start = end - (uint64_t)num_copied;
+
+    FORI(0, silent) {
+        if(left != NULL) {
+            left[i] = 0.0f;
+        }
+        if(right != NULL) {
+            right[i] = 0.0f;
+        }
+    }
 
-    float* first_half = pcm->ring_left + pcm->num_samples - floats_from_end;
-    memcpy(dst, first_half, (size_t)floats_from_end * sizeof(float));
+    if(left != NULL) {
+        memcpy(left + silent, ring_at(pcm->ring_left, start), (size_t)num_copied * sizeof(float));
+    }
+    if(right != NULL) {
+        memcpy(right + silent, ring_at(pcm->ring_right, start), (size_t)num_copied * sizeof(float));
+    }
 
-    float* second_half = pcm->ring_left + offset - floats_to_start;
-    memcpy(dst + floats_from_end, second_half, (size_t)floats_to_start * sizeof(float));
+    // Did the producer start overwriting `[start, end)` while we were copying?
+    atomic_thread_fence(memory_order_acquire);
+    uint64_t claimed = atomic_load_explicit(&pcm->claimed_index, memory_order_relaxed);
+    bool is_consistent = claimed - start <= (uint64_t)pcm->num_samples;
+    if(!is_consistent) {
+        pcm->stats.torn_reads++;
+    }
+    return is_consistent;
+}
+
+__attribute__((pure)) struct PcmStats get_pcm_stats(Pcm pcm) { return pcm->stats; }
+
+void copy_pcm_to_gpu(Pcm pcm) {
+    // Everything before `sample_index` is published. The producer may already
+    // be writing the oldest part of the ring, which shaders should not rely on.
+    uint64_t sample_index = pcm_sample_index(pcm);
+    if(sample_index == pcm->gpu_index) {
+        return;
+    }
+
+    // Only the samples since the last upload, one or two ranges depending on
+    // whether they wrap. If the producer lapped us, everything.
+    uint64_t num_new = sample_index - pcm->gpu_index;
+    if(num_new >= (uint64_t)pcm->num_samples) {
+        copy_pcm_ring_to_gpu(pcm, 0, pcm->num_samples);
+    } else {
+        int first = (int)(pcm->gpu_index % (uint64_t)pcm->num_samples);
+        int num_before_wrap = MIN((int)num_new, pcm->num_samples - first);
+        copy_pcm_ring_to_gpu(pcm, first, num_before_wrap);
+        if(num_before_wrap < (int)num_new) {
+            copy_pcm_ring_to_gpu(pcm, 0, (int)num_new - num_before_wrap);
+        }
+    }
+    pcm->gpu_index = sample_index;
+
+    // The 31 bit index doesn't wrap together with the ring, so its position goes up too.
+    int gpu_sample_index = (int)(sample_index & INT32_MAX);
+    int offset = (int)(sample_index % (uint64_t)pcm->num_samples);
+    copy_buffer_to_gpu(pcm->buffer, &gpu_sample_index, sizeof(int), sizeof(int));
+    copy_buffer_to_gpu(pcm->buffer, &offset, 3 * isizeof(int), sizeof(int));
+    commit_buffer_to_gpu(pcm->buffer);
 }
 
 void delete_pcm(Pcm pcm) {
+    pthread_cond_destroy(&pcm->wake_condition);
+    pthread_mutex_destroy(&pcm->wake_mutex);
     delete_buffer(pcm->buffer);
-    free(pcm->ring_left);
-    free(pcm->ring_right);
+    delete_ring_buffer(pcm->ring_left);
+    delete_ring_buffer(pcm->ring_right);
     free(pcm);
 }
 
 struct ThreadData {
-    bool close_requested;
+    atomic_bool close_requested;
     Pcm pcm;
 };
 
-#include<math.h>
-
 void* input_stream_function(void* data_raw) {
     struct ThreadData* data = (struct ThreadData*)data_raw;
     Pcm pcm = data->pcm;
 
-    // Initialize input byte buffer.
-    int num_buffer_floats = 4096;
-    int buffer_size = num_buffer_floats * isizeof(float);
-    // 1 extra char to use with `read`.
-    float* buffer_floats = malloc((size_t)buffer_size + 1);
-    char* buffer_bytes = (char*)buffer_floats;
-    int buffer_offset = 0;
-
-    // Unblock stdin.
-    fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
-
-    while(!data->close_requested) {
-        // Read as many as possible up to end of `buffer` from stdin.
-        int res = (int)read(STDIN_FILENO, buffer_bytes + buffer_offset, (size_t)(buffer_size - buffer_offset));
-        if(res != -1) {
-            buffer_offset += res;
+    // Staging area for `read`. Complete samples are converted and go into the
+    // ring, an incomplete one at the end is carried over to the front.
+    struct PcmFormat format = pcm->format;
+    int const bytes_per_sample = format.channels * bytes_per_value(format.sample_format);
+    int staging_size = 4096 * isizeof(float);
+    float* staging_floats = malloc((size_t)staging_size);
+    char* staging_bytes = (char*)staging_floats;
+    int carry = 0;
+
+    // Float input skips the conversion.
+    bool is_float = format.sample_format == SAMPLE_FORMAT_F32LE;
+    int num_converted_floats = staging_size / bytes_per_value(format.sample_format);
+    float* converted = is_float ? staging_floats : malloc((size_t)num_converted_floats * sizeof(float));
+
+    // Block in `poll` instead of spinning on a non-blocking `read`. The timeout
+    // only bounds how long it takes to notice `close_requested`.
+    struct pollfd stdin_poll = {.fd = STDIN_FILENO, .events = POLLIN, .revents = 0};
+    int const poll_timeout_ms = 100;
+
+    while(!atomic_load_explicit(&data->close_requested, memory_order_relaxed)) {
+        int num_ready = poll(&stdin_poll, 1, poll_timeout_ms);
+        if(num_ready == 0 || (num_ready == -1 && errno == EINTR)) {
+            continue;
+        }
+        if(num_ready == -1) {
+            fprintf(stderr, "Failed to poll stdin\n");
+            break;
         }
 
-        int samples_available = buffer_offset / 8; // 4 bytes per float. 2 floats per sample.
-        int samples_fitting = pcm->num_samples - pcm->offset;
-
-        int before_wrap = MIN(samples_fitting, samples_available);
-        int after_wrap = samples_available - samples_fitting;
+        // Read as many as possible up to end of the staging area from stdin.
+        int res = (int)read(STDIN_FILENO, staging_bytes + carry, (size_t)(staging_size - carry));
+        if(res == 0) {
+            fprintf(stderr, "End of PCM input\n");
+            break;
+        }
+        if(res == -1) {
+            continue;
+        }
 
-        for(int i = 0; i < before_wrap; i++) {
-            pcm->ring_left[pcm->offset + i] = buffer_floats[2 * i];
-            pcm->ring_right[pcm->offset + i] = buffer_floats[2 * i + 1];
+        int bytes_available = carry + res;
+        int samples_available = bytes_available / bytes_per_sample;
+        if(samples_available == 0) {
+            carry = bytes_available;
+            continue;
         }
-        for(int i = 0; i < after_wrap; i++) {
-            pcm->ring_left[i] = buffer_floats[2 * (before_wrap + i)];
-            pcm->ring_right[i] = buffer_floats[2 * (before_wrap + i) + 1];
+        if(!is_float) {
+            convert_to_float(format.sample_format, staging_bytes, converted, samples_available * format.channels);
         }
+        write_pcm_samples(pcm, converted, samples_available);
 
-        pcm->sample_index += samples_available;
-        pcm->offset = (pcm->offset + samples_available) % pcm->num_samples;
-
-        assert(pcm->offset == pcm->sample_index % pcm->num_samples);
-
-        // Move multiples of 2 floats over to ringbuffer and update position.
-        // Can't use the memcpy aproach since i need to split the channels.
-        /* float* dest = data->pcm_ring_buffer + data->pcm_offset; */
-        /* memcpy(dest, buffer_bytes, floats_moved * sizeof(float)); */
-        /* int floats_left = floats_available - floats_moved; */
-        /* memcpy(data->pcm_ring_buffer, buffer_bytes + floats_moved * sizeof(float), floats_left * sizeof(float)); */
-        /* data->pcm_offset = (data->pcm_offset + floats_available) % (data->pcm_samples * 2); */
-
-        // Move rest of bytes to beginning of buffer.
-        int bytes_processed = 2 * samples_available * isizeof(float);
-        int bytes_left = buffer_offset - bytes_processed;
-        // Regions may overlap!
-        memmove(buffer_bytes, buffer_bytes + bytes_processed, (size_t)bytes_left);
-        buffer_offset = bytes_left;
+        // Less than a sample is left over, the regions don't overlap.
+        int bytes_processed = samples_available * bytes_per_sample;
+        carry = bytes_available - bytes_processed;
+        memcpy(staging_bytes, staging_bytes + bytes_processed, (size_t)carry);
     }
 
-    free(buffer_bytes);
+    if(!is_float) {
+        free(converted);
+    }
+    free(staging_floats);
 
     return NULL;
 }
@@ -169,7 +341,7 @@ struct PcmStream_ {
 PcmStream create_pcm_stream(Pcm pcm) {
     PcmStream pcm_stream = (struct PcmStream_*)malloc(sizeof(struct PcmStream_));
     pcm_stream->thread_data = malloc(sizeof(struct ThreadData));
-    pcm_stream->thread_data->close_requested = false;
+    atomic_init(&pcm_stream->thread_data->close_requested, false);
     pcm_stream->thread_data->pcm = pcm;
 
     int failure = pthread_create(&pcm_stream->thread, NULL, input_stream_function, (void*)pcm_stream->thread_data);
@@ -182,7 +354,7 @@ PcmStream create_pcm_stream(Pcm pcm) {
 }
 
 void delete_pcm_stream(PcmStream pcm_stream) {
-    pcm_stream->thread_data->close_requested = true;
+    atomic_store(&pcm_stream->thread_data->close_requested, true);
     pthread_join(pcm_stream->thread, NULL);
     free(pcm_stream->thread_data);
     free(pcm_stream);
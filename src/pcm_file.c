@@ -0,0 +1,276 @@
+// Required for madvise.
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "globals.h"
+#include "pcm.h"
+#include "pcm_file.h"
+#include "simd.h"
+
+struct PcmFile_ {
+    char const* path;
+    struct PcmFormat format;
+    // Sun AU files are usually big endian.
+    bool is_big_endian;
+
+    uint8_t* mapping;
+    size_t mapping_size;
+    uint8_t const* data;
+    uint64_t num_samples;
+
+    // Next sample to be written.
+    uint64_t position;
+    // Wall time of the first `play_pcm_file`, negative if not started.
+    double play_start;
+
+    // Conversion buffers for one chunk.
+    int chunk_samples;
+    uint8_t* swapped;
+    float* converted;
+};
+
+__attribute__((noreturn)) void fail_pcm_file(PcmFile pcm_file, char const* message) {
+    fprintf(stderr, "%s: %s\n", pcm_file->path, message);
+    exit(1);
+}
+
+__attribute__((pure)) uint32_t read_le32(uint8_t const* b) {
+    return (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+__attribute__((pure)) uint16_t read_le16(uint8_t const* b) { return (uint16_t)(b[0] | b[1] << 8); }
+
+__attribute__((pure)) uint32_t read_be32(uint8_t const* b) {
+    return (uint32_t)b[3] | (uint32_t)b[2] << 8 | (uint32_t)b[1] << 16 | (uint32_t)b[0] << 24;
+}
+
+// The header's or the raw format, before anything divides by the sample size.
+// The parsers only set known sample formats.
+void check_pcm_file_format(PcmFile pcm_file) {
+    struct PcmFormat format = pcm_file->format;
+    if(format.channels < 1 || format.channels > 8 || format.sample_rate <= 0) {
+        fail_pcm_file(pcm_file, "unsupported channel count or sample rate");
+    }
+}
+
+void set_data(PcmFile pcm_file, uint64_t offset, uint64_t size) {
+    check_pcm_file_format(pcm_file);
+    if(offset > pcm_file->mapping_size) {
+        fail_pcm_file(pcm_file, "data starts past the end of the file");
+    }
+    // Truncated files and unknown sizes just use what is there.
+    size = MIN(size, pcm_file->mapping_size - offset);
+    int bytes_per_sample = pcm_file->format.channels * bytes_per_value(pcm_file->format.sample_format);
+    pcm_file->data = pcm_file->mapping + offset;
+    pcm_file->num_samples = size / (uint64_t)bytes_per_sample;
+}
+
+bool parse_wav_header(PcmFile pcm_file) {
+    uint8_t const* bytes = pcm_file->mapping;
+    size_t size = pcm_file->mapping_size;
+    if(size < 12 || memcmp(bytes, "RIFF", 4) != 0 || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        return false;
+    }
+
+    bool has_format = false;
+    size_t offset = 12;
+    while(offset + 8 <= size) {
+        uint8_t const* chunk = bytes + offset;
+        uint32_t chunk_size = read_le32(chunk + 4);
+
+        if(memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && offset + 8 + 16 <= size) {
+            uint16_t tag = read_le16(chunk + 8);
+            uint16_t bits = read_le16(chunk + 22);
+            // WAVE_FORMAT_EXTENSIBLE keeps the actual tag in the sub format GUID.
+            if(tag == 0xFFFE && chunk_size >= 40 && offset + 8 + 40 <= size) {
+                tag = read_le16(chunk + 32);
+            }
+
+            pcm_file->format.channels = read_le16(chunk + 10);
+            pcm_file->format.sample_rate = (int)read_le32(chunk + 12);
+            if(tag == 1 && bits == 8) {
+                pcm_file->format.sample_format = SAMPLE_FORMAT_U8;
+            } else if(tag == 1 && bits == 16) {
+                pcm_file->format.sample_format = SAMPLE_FORMAT_S16LE;
+            } else if(tag == 1 && bits == 24) {
+                pcm_file->format.sample_format = SAMPLE_FORMAT_S24LE;
+            } else if(tag == 1 && bits == 32) {
+                pcm_file->format.sample_format = SAMPLE_FORMAT_S32LE;
+            } else if(tag == 3 && bits == 32) {
+                pcm_file->format.sample_format = SAMPLE_FORMAT_F32LE;
+            } else {
+                fail_pcm_file(pcm_file, "unsupported WAV sample format");
+            }
+            has_format = true;
+        } else if(memcmp(chunk, "data", 4) == 0) {
+            if(!has_format) {
+                fail_pcm_file(pcm_file, "WAV data chunk before format chunk");
+            }
+            set_data(pcm_file, offset + 8, chunk_size);
+            return true;
+        }
+
+        // Chunks are padded to an even size.
+        offset += 8 + (size_t)chunk_size + (chunk_size & 1);
+    }
+
+    fail_pcm_file(pcm_file, "WAV file without data chunk");
+}
+
+bool parse_au_header(PcmFile pcm_file) {
+    uint8_t const* bytes = pcm_file->mapping;
+    if(pcm_file->mapping_size < 24) {
+        return false;
+    }
+
+    // Audacity writes little endian files with a reversed magic.
+    uint32_t (*read32)(uint8_t const*);
+    if(memcmp(bytes, ".snd", 4) == 0) {
+        read32 = read_be32;
+        pcm_file->is_big_endian = true;
+    } else if(memcmp(bytes, "dns.", 4) == 0) {
+        read32 = read_le32;
+        pcm_file->is_big_endian = false;
+    } else {
+        return false;
+    }
+
+    uint32_t data_offset = read32(bytes + 4);
+    if(data_offset < 24) {
+        fail_pcm_file(pcm_file, "AU data starts inside the header");
+    }
+    uint32_t data_size = read32(bytes + 8);
+    uint32_t encoding = read32(bytes + 12);
+    pcm_file->format.sample_rate = (int)read32(bytes + 16);
+    pcm_file->format.channels = (int)read32(bytes + 20);
+
+    switch(encoding) {
+    case 3:
+        pcm_file->format.sample_format = SAMPLE_FORMAT_S16LE;
+        break;
+    case 4:
+        pcm_file->format.sample_format = SAMPLE_FORMAT_S24LE;
+        break;
+    case 5:
+        pcm_file->format.sample_format = SAMPLE_FORMAT_S32LE;
+        break;
+    case 6:
+        pcm_file->format.sample_format = SAMPLE_FORMAT_F32LE;
+        break;
+    default:
+        fail_pcm_file(pcm_file, "unsupported AU encoding");
+    }
+
+    // 0xffffffff means unknown, i.e. until the end of the file.
+    set_data(pcm_file, data_offset, data_size == UINT32_MAX ? UINT64_MAX : data_size);
+    return true;
+}
+
+PcmFile create_pcm_file(char const* path, struct PcmFormat raw_format) {
+    PcmFile pcm_file = (PcmFile)malloc(sizeof(struct PcmFile_));
+    pcm_file->path = path;
+    pcm_file->format = raw_format;
+    pcm_file->is_big_endian = false;
+    pcm_file->position = 0;
+    pcm_file->play_start = -1.0;
+
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) {
+        fail_pcm_file(pcm_file, "cannot open file");
+    }
+
+    struct stat attr;
+    if(fstat(fd, &attr) != 0 || attr.st_size == 0) {
+        fail_pcm_file(pcm_file, "cannot map an empty file");
+    }
+    pcm_file->mapping_size = (size_t)attr.st_size;
+
+    void* mapping = mmap(NULL, pcm_file->mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        fail_pcm_file(pcm_file, "failed to mmap");
+    }
+    pcm_file->mapping = mapping;
+    madvise(mapping, pcm_file->mapping_size, MADV_SEQUENTIAL);
+
+    if(!parse_wav_header(pcm_file) && !parse_au_header(pcm_file)) {
+        set_data(pcm_file, 0, pcm_file->mapping_size);
+    }
+
+    pcm_file->chunk_samples = 4096;
+    int chunk_values = pcm_file->chunk_samples * pcm_file->format.channels;
+    pcm_file->swapped = ALLOCATE(chunk_values * bytes_per_value(pcm_file->format.sample_format), uint8_t);
+    pcm_file->converted = ALLOCATE(chunk_values, float);
+
+    return pcm_file;
+}
+
+__attribute__((pure)) struct PcmFormat format_of_pcm_file(PcmFile pcm_file) { return pcm_file->format; }
+
+__attribute__((pure)) uint64_t num_samples_of_pcm_file(PcmFile pcm_file) { return pcm_file->num_samples; }
+
+__attribute__((pure)) bool pcm_file_finished(PcmFile pcm_file) {
+    return pcm_file->position >= pcm_file->num_samples;
+}
+
+void write_pcm_file_chunk(PcmFile pcm_file, Pcm pcm, int num_samples) {
+    int value_size = bytes_per_value(pcm_file->format.sample_format);
+    int num_values = num_samples * pcm_file->format.channels;
+    uint8_t const* src = pcm_file->data + pcm_file->position * (uint64_t)(pcm_file->format.channels * value_size);
+
+    if(pcm_file->is_big_endian) {
+        FORI(0, num_values) {
+            for(int j = 0; j < value_size; j++) {
+                pcm_file->swapped[i * value_size + j] = src[i * value_size + value_size - 1 - j];
+            }
+        }
+        src = pcm_file->swapped;
+    }
+
+    convert_to_float(pcm_file->format.sample_format, src, pcm_file->converted, num_values);
+    write_pcm_samples(pcm, pcm_file->converted, num_samples);
+    pcm_file->position += (uint64_t)num_samples;
+}
+
+int advance_pcm_file(PcmFile pcm_file, Pcm pcm, int num_samples) {
+    uint64_t remaining = pcm_file->num_samples - pcm_file->position;
+    int num_written = (int)MIN((uint64_t)num_samples, remaining);
+
+    for(int written = 0; written < num_written;) {
+        int chunk = MIN(num_written - written, pcm_file->chunk_samples);
+        write_pcm_file_chunk(pcm_file, pcm, chunk);
+        written += chunk;
+    }
+
+    return num_written;
+}
+
+int play_pcm_file(PcmFile pcm_file, Pcm pcm) {
+    double now = get_monotonic_seconds();
+    if(pcm_file->play_start < 0.0) {
+        pcm_file->play_start = now;
+    }
+
+    uint64_t due = (uint64_t)((now - pcm_file->play_start) * (double)pcm_file->format.sample_rate);
+    if(due <= pcm_file->position) {
+        return 0;
+    }
+    return advance_pcm_file(pcm_file, pcm, (int)MIN(due - pcm_file->position, (uint64_t)INT32_MAX));
+}
+
+void delete_pcm_file(PcmFile pcm_file) {
+    munmap(pcm_file->mapping, pcm_file->mapping_size);
+    free(pcm_file->swapped);
+    free(pcm_file->converted);
+    free(pcm_file);
+}
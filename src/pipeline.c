@@ -0,0 +1,215 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "pipeline.h"
+
+// Seconds between two stats lines.
+#define PIPELINE_STATS_INTERVAL_S 2.0
+
+// Everything the render thread uploads, copied out by the worker.
+struct Snapshot {
+    float* dft;
+    float* cqt;
+    float* filterbank;
+    struct GpuData* analysis;
+
+    struct PipelineTimings timings;
+    uint64_t dropped_frames;
+    struct PcmStats pcm_stats;
+};
+
+// Marks the middle snapshot as not yet picked up.
+#define SNAPSHOT_FRESH 4
+
+struct Pipeline_ {
+    Pcm pcm;
+    DftData dft_data;
+    Cqt cqt;
+    Filterbank filterbank;
+    Analysis analysis;
+    Spectrogram spectrogram;
+    int wake_samples;
+
+    int dft_floats;
+    int cqt_floats;
+    int filterbank_floats;
+    int analysis_size;
+
+    // Triple buffer. The worker fills the `back` snapshot and the render thread
+    // uploads the `front` one. Either swaps its own with `middle` when done, so
+    // neither ever waits and the render thread always gets the newest results.
+    struct Snapshot snapshots[3];
+    int back;
+    _Atomic int middle;
+    int front;
+
+    pthread_t thread;
+    atomic_bool stop_requested;
+
+    // Render thread side.
+    bool stats;
+    double stats_start;
+    uint64_t num_uploads;
+    double upload_s;
+    struct PipelineTimings last_timings;
+};
+
+void fill_snapshot(Pipeline pipeline, struct Snapshot* snapshot, struct PipelineTimings const* timings) {
+    memcpy(snapshot->dft, newest_magnitudes_of_dft(pipeline->dft_data), (size_t)pipeline->dft_floats * sizeof(float));
+    memcpy(snapshot->cqt, magnitudes_of_cqt(pipeline->cqt), (size_t)pipeline->cqt_floats * sizeof(float));
+    memcpy(snapshot->filterbank, bands_of_filterbank(pipeline->filterbank),
+           (size_t)pipeline->filterbank_floats * sizeof(float));
+    memcpy(snapshot->analysis, gpu_data_of_analysis(pipeline->analysis), (size_t)pipeline->analysis_size);
+
+    snapshot->timings = *timings;
+    snapshot->dropped_frames = dropped_frames_of_dft(pipeline->dft_data);
+    snapshot->pcm_stats = get_pcm_stats(pipeline->pcm);
+}
+
+void* pipeline_thread_function(void* data) {
+    Pipeline pipeline = (Pipeline)data;
+    struct PipelineTimings timings = {0};
+    // Only bounds how long it takes to notice `stop_requested`.
+    int const wake_timeout_ms = 100;
+
+    while(!atomic_load_explicit(&pipeline->stop_requested, memory_order_relaxed)) {
+        wait_for_pcm_samples(pipeline->pcm, pipeline->wake_samples, wake_timeout_ms);
+
+        double start = get_monotonic_seconds();
+        int num_frames = compute_dft_frames(pipeline->pcm, pipeline->dft_data);
+        if(num_frames == 0) {
+            continue;
+        }
+        add_spectrogram_rows(pipeline->spectrogram, pipeline->dft_data, num_frames);
+        double dft_end = get_monotonic_seconds();
+
+        while(next_dft_frame(pipeline->dft_data)) {
+            analyze_dft_frame(pipeline->pcm, pipeline->dft_data, pipeline->analysis);
+        }
+        double analysis_end = get_monotonic_seconds();
+
+        timings.hops += (uint64_t)num_frames;
+        timings.publishes++;
+        timings.dft_s += dft_end - start;
+        timings.analysis_s += analysis_end - dft_end;
+        fill_snapshot(pipeline, pipeline->snapshots + pipeline->back, &timings);
+        int middle = atomic_exchange_explicit(&pipeline->middle, pipeline->back | SNAPSHOT_FRESH, memory_order_acq_rel);
+        pipeline->back = middle & ~SNAPSHOT_FRESH;
+        // Shows up in the next snapshot.
+        timings.publish_s += get_monotonic_seconds() - analysis_end;
+    }
+
+    return NULL;
+}
+
+Pipeline create_pipeline(Pcm pcm, DftData dft_data, Cqt cqt, Filterbank filterbank, Analysis analysis,
+                         Spectrogram spectrogram, int wake_samples, bool stats) {
+    Pipeline pipeline = ALLOCATE(1, struct Pipeline_);
+    pipeline->pcm = pcm;
+    pipeline->dft_data = dft_data;
+    pipeline->cqt = cqt;
+    pipeline->filterbank = filterbank;
+    pipeline->analysis = analysis;
+    pipeline->spectrogram = spectrogram;
+    pipeline->wake_samples = wake_samples;
+
+    pipeline->dft_floats = num_channels_of_dft(dft_data) * (size_of_dft(dft_data) / 2 + 1);
+    pipeline->cqt_floats = num_bins_of_cqt(cqt);
+    pipeline->filterbank_floats = num_bands_of_filterbank(filterbank);
+    pipeline->analysis_size = gpu_data_size_of_analysis(analysis);
+    FORI(0, 3) {
+        pipeline->snapshots[i].dft = ALLOCATE(pipeline->dft_floats, float);
+        pipeline->snapshots[i].cqt = ALLOCATE(pipeline->cqt_floats, float);
+        pipeline->snapshots[i].filterbank = ALLOCATE(pipeline->filterbank_floats, float);
+        pipeline->snapshots[i].analysis = (struct GpuData*)malloc((size_t)pipeline->analysis_size);
+        pipeline->snapshots[i].timings = (struct PipelineTimings){0};
+    }
+    pipeline->back = 0;
+    atomic_init(&pipeline->middle, 1);
+    pipeline->front = 2;
+
+    pipeline->stats = stats;
+    pipeline->stats_start = get_monotonic_seconds();
+    pipeline->num_uploads = 0;
+    pipeline->upload_s = 0.0;
+    pipeline->last_timings = (struct PipelineTimings){0};
+
+    atomic_init(&pipeline->stop_requested, false);
+    int failure = pthread_create(&pipeline->thread, NULL, pipeline_thread_function, (void*)pipeline);
+    if(failure) {
+        fprintf(stderr, "Failed to pthread_create\n");
+        exit(1);
+    }
+
+    return pipeline;
+}
+
+void print_pipeline_stats(Pipeline pipeline, struct Snapshot const* snapshot) {
+    double now = get_monotonic_seconds();
+    double elapsed = now - pipeline->stats_start;
+    if(elapsed < PIPELINE_STATS_INTERVAL_S) {
+        return;
+    }
+
+    struct PipelineTimings const* timings = &snapshot->timings;
+    struct PipelineTimings const* last = &pipeline->last_timings;
+    double hops = (double)MAX(timings->hops - last->hops, 1);
+    double publishes = (double)MAX(timings->publishes - last->publishes, 1);
+    double uploads = (double)MAX(pipeline->num_uploads, 1);
+    printf("Pipeline: %.0f hops/s, dft %.3f ms and analysis %.3f ms per hop, publish %.3f ms, "
+           "upload %.3f ms at %.0f/s, %llu dropped frames, %llu xruns\n",
+           hops / elapsed, 1000.0 * (timings->dft_s - last->dft_s) / hops,
+           1000.0 * (timings->analysis_s - last->analysis_s) / hops,
+           1000.0 * (timings->publish_s - last->publish_s) / publishes, 1000.0 * pipeline->upload_s / uploads,
+           (double)pipeline->num_uploads / elapsed, (unsigned long long)snapshot->dropped_frames,
+           (unsigned long long)snapshot->pcm_stats.xruns);
+
+    pipeline->last_timings = *timings;
+    pipeline->stats_start = now;
+    pipeline->num_uploads = 0;
+    pipeline->upload_s = 0.0;
+}
+
+void copy_pipeline_to_gpu(Pipeline pipeline) {
+    if(!(atomic_load_explicit(&pipeline->middle, memory_order_relaxed) & SNAPSHOT_FRESH)) {
+        return;
+    }
+    int middle = atomic_exchange_explicit(&pipeline->middle, pipeline->front, memory_order_acq_rel);
+    pipeline->front = middle & ~SNAPSHOT_FRESH;
+    struct Snapshot const* snapshot = pipeline->snapshots + pipeline->front;
+
+    // Only the GPU buffers of the modules are touched here, the worker doesn't.
+    double start = get_monotonic_seconds();
+    copy_dft_magnitudes_to_gpu(pipeline->dft_data, snapshot->dft);
+    copy_cqt_magnitudes_to_gpu(pipeline->cqt, snapshot->cqt);
+    copy_filterbank_bands_to_gpu(pipeline->filterbank, snapshot->filterbank);
+    copy_analysis_data_to_gpu(pipeline->analysis, snapshot->analysis);
+    copy_spectrogram_to_gpu(pipeline->spectrogram);
+    pipeline->upload_s += get_monotonic_seconds() - start;
+    pipeline->num_uploads++;
+
+    if(pipeline->stats) {
+        print_pipeline_stats(pipeline, snapshot);
+    }
+}
+
+__attribute__((pure)) struct PipelineTimings timings_of_pipeline(Pipeline pipeline) {
+    return pipeline->snapshots[pipeline->front].timings;
+}
+
+void delete_pipeline(Pipeline pipeline) {
+    atomic_store(&pipeline->stop_requested, true);
+    pthread_join(pipeline->thread, NULL);
+    FORI(0, 3) {
+        free(pipeline->snapshots[i].dft);
+        free(pipeline->snapshots[i].cqt);
+        free(pipeline->snapshots[i].filterbank);
+        free(pipeline->snapshots[i].analysis);
+    }
+    free(pipeline);
+}
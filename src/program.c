@@ -1,6 +1,7 @@
 // See https://antongerdelan.net/opengl/compute.html for reference.
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <time.h> // TODO
 
 #include <sys/stat.h>
@@ -12,14 +13,23 @@
 #include <SDL2/SDL_opengl.h>
 #include <SDL2/SDL_opengl_glext.h>
 
+#include "globals.h"
 #include "program.h"
 
 struct Program_ {
     char const* compute_shader_path;
+    char const* prelude;
     time_t compute_shader_mtime;
     GLuint compute_shader;
 
     GLuint program;
+    // Images the installed program uses.
+    struct ImageFormats image_formats;
+
+    // The program the last reinstall replaced, -1 once it's gone.
+    GLuint previous_compute_shader;
+    GLuint previous_program;
+    struct ImageFormats previous_image_formats;
 };
 
 char* read_file(char const* path, int* size) {
@@ -69,29 +79,85 @@ time_t get_mtime(char const* path) {
     return attr.st_mtime;
 }
 
-Program create_program(char const* compute_shader_path) {
+Program create_program(char const* compute_shader_path, char const* prelude) {
     Program program = (struct Program_*)malloc(sizeof(struct Program_));
 
     program->compute_shader_path = compute_shader_path;
+    program->prelude = prelude;
     program->compute_shader = (GLuint)-1;
     program->program = (GLuint)-1;
+    program->image_formats = (struct ImageFormats){0};
+    program->previous_compute_shader = (GLuint)-1;
+    program->previous_program = (GLuint)-1;
+    program->previous_image_formats = (struct ImageFormats){0};
 
     reinstall_program_if_valid(program);
 
     return program;
 }
 
-GLuint compile_shader(GLenum type, char const* source_path) {
+static struct {
+    char const* name;
+    GLenum format;
+} const image_format_names[] = {
+    {"rgba32f", GL_RGBA32F}, {"rgba16f", GL_RGBA16F}, {"r11f_g11f_b10f", GL_R11F_G11F_B10F},
+    {"rgba8", GL_RGBA8},     {"r32f", GL_R32F},       {"r16f", GL_R16F},
+};
+
+// Formats of the `layout(<format>, binding = <unit>) uniform image2D` lines, 0 for the other units.
+bool parse_image_formats(char const* source, char const* source_path, GLenum* formats) {
+    FORI(0, NUM_IMAGES) { formats[i] = 0; }
+
+    char const* line = source;
+    while(line != NULL) {
+        char name[32];
+        int unit;
+        int end = 0;
+        sscanf(line, " layout ( %31[a-z0-9_] , binding = %d ) uniform image2D%n", name, &unit, &end);
+        if(end > 0) {
+            if(unit < 0 || unit >= NUM_IMAGES) {
+                fprintf(stderr, "%s: image binding %d is not one of the %d images\n", source_path, unit, NUM_IMAGES);
+                return false;
+            }
+            formats[unit] = 0;
+            FORI(0, isizeof(image_format_names) / isizeof(image_format_names[0])) {
+                if(strcmp(name, image_format_names[i].name) == 0) {
+                    formats[unit] = image_format_names[i].format;
+                }
+            }
+            if(formats[unit] == 0) {
+                fprintf(stderr, "%s: unsupported image format %s\n", source_path, name);
+                return false;
+            }
+        }
+
+        line = strchr(line, '\n');
+        line = line == NULL ? NULL : line + 1;
+    }
+    return true;
+}
+
+GLuint compile_shader(GLenum type, char const* source_path, char const* prelude, GLenum* image_formats) {
     GLuint shader = glCreateShader(type);
 
     int source_len;
     char* source = read_file(source_path, &source_len);
-    char const* const_source = source;
 
-    glShaderSource(shader, 1, (GLchar const**)&const_source, &source_len);
+    // `#version` has to come first, `#line` keeps the line numbers in errors those of the file.
+    char const* rest = strchr(source, '\n');
+    rest = rest == NULL ? source + source_len : rest + 1;
+    char const* parts[] = {source, prelude, "\n#line 2\n", rest};
+    GLint lengths[] = {(GLint)(rest - source), (GLint)strlen(prelude), -1, -1};
+
+    glShaderSource(shader, 4, (GLchar const**)parts, lengths);
     glCompileShader(shader);
 
+    bool formats_valid = parse_image_formats(source, source_path, image_formats);
     free(source);
+    if(!formats_valid) {
+        glDeleteShader(shader);
+        return (GLuint)-1;
+    }
 
     GLint status;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
@@ -109,6 +175,35 @@ GLuint compile_shader(GLenum type, char const* source_path) {
     return shader;
 }
 
+// Keeps the declared formats of the images `prgm` uses, the compiler drops the others.
+bool used_image_formats(GLuint prgm, char const* source_path, GLenum const* declared,
+                        struct ImageFormats* image_formats) {
+    *image_formats = (struct ImageFormats){0};
+
+    GLint num_uniforms = 0;
+    glGetProgramInterfaceiv(prgm, GL_UNIFORM, GL_ACTIVE_RESOURCES, &num_uniforms);
+    FORI(0, num_uniforms) {
+        GLenum const properties[] = {GL_TYPE, GL_LOCATION};
+        GLint values[2];
+        glGetProgramResourceiv(prgm, GL_UNIFORM, (GLuint)i, 2, properties, 2, NULL, values);
+        if(values[0] != GL_IMAGE_2D) {
+            continue;
+        }
+
+        GLint unit;
+        glGetUniformiv(prgm, values[1], &unit);
+        if(unit < 0 || unit >= NUM_IMAGES || declared[unit] == 0) {
+            fprintf(stderr, "%s: image unit %d has no supported format\n", source_path, unit);
+            return false;
+        }
+        if(!add_image_format(image_formats, (enum Image)unit, declared[unit])) {
+            fprintf(stderr, "%s: back and front images need the same format\n", source_path);
+            return false;
+        }
+    }
+    return true;
+}
+
 bool program_source_modified(Program program) {
     return get_mtime(program->compute_shader_path) > program->compute_shader_mtime;
 }
@@ -118,7 +213,16 @@ void uninstall_program(Program program) {
     glDeleteShader(program->compute_shader);
 }
 
-void reinstall_program_if_valid(Program program) {
+void discard_previous_program(Program program) {
+    if(program->previous_program != (GLuint)-1) {
+        glDeleteProgram(program->previous_program);
+        glDeleteShader(program->previous_compute_shader);
+        program->previous_compute_shader = (GLuint)-1;
+        program->previous_program = (GLuint)-1;
+    }
+}
+
+bool reinstall_program_if_valid(Program program) {
     time_t t = time(NULL);
     struct tm* localized_time = localtime(&t);
     char s[1000];
@@ -127,9 +231,11 @@ void reinstall_program_if_valid(Program program) {
 
     program->compute_shader_mtime = get_mtime(program->compute_shader_path);
 
-    GLuint compute_shader = compile_shader(GL_COMPUTE_SHADER, program->compute_shader_path);
+    GLenum declared_formats[NUM_IMAGES];
+    GLuint compute_shader =
+        compile_shader(GL_COMPUTE_SHADER, program->compute_shader_path, program->prelude, declared_formats);
     if(compute_shader == (GLuint)-1) {
-        return;
+        return false;
     }
 
     GLuint prgm = glCreateProgram();
@@ -149,30 +255,79 @@ void reinstall_program_if_valid(Program program) {
         glDeleteProgram(prgm);
         glDeleteShader(compute_shader);
 
-        return;
+        return false;
     }
 
-    if(program->program != (GLuint)-1) {
-        uninstall_program(program);
+    struct ImageFormats used_formats;
+    if(!used_image_formats(prgm, program->compute_shader_path, declared_formats, &used_formats)) {
+        glDeleteProgram(prgm);
+        glDeleteShader(compute_shader);
+
+        return false;
     }
 
+    // Kept until the next reinstall, in case the new one doesn't fit with the other programs.
+    discard_previous_program(program);
+    program->previous_compute_shader = program->compute_shader;
+    program->previous_program = program->program;
+    program->previous_image_formats = program->image_formats;
+
     program->compute_shader = compute_shader;
     program->program = prgm;
+    program->image_formats = used_formats;
 
     glUseProgram(prgm);
+    return true;
 }
 
-void reinstall_program_if_modified(Program program) {
+bool reinstall_program_if_modified(Program program) {
     if(program_source_modified(program)) {
-        reinstall_program_if_valid(program);
+        return reinstall_program_if_valid(program);
     }
+    return false;
+}
+
+bool restore_previous_program(Program program) {
+    if(program->previous_program == (GLuint)-1) {
+        return false;
+    }
+    uninstall_program(program);
+    program->compute_shader = program->previous_compute_shader;
+    program->program = program->previous_program;
+    program->image_formats = program->previous_image_formats;
+    program->previous_compute_shader = (GLuint)-1;
+    program->previous_program = (GLuint)-1;
+
+    glUseProgram(program->program);
+    return true;
+}
+
+bool add_program_image_formats(Program program, struct ImageFormats* image_formats) {
+    bool consistent = true;
+    FORI(0, NUM_IMAGES) {
+        GLenum format = program->image_formats.formats[i];
+        if(format != 0 && !add_image_format(image_formats, (enum Image)i, format)) {
+            fprintf(stderr, "%s: image %d has a different format in another program\n", program->compute_shader_path,
+                    i);
+            consistent = false;
+        }
+    }
+    return consistent;
+}
+
+bool program_uses_uniform_block(Program program, char const* name) {
+    return glGetProgramResourceIndex(program->program, GL_UNIFORM_BLOCK, name) != GL_INVALID_INDEX;
 }
 
 void run_program(Program program, GLuint w, GLuint h) {
     glUseProgram(program->program);
-    glDispatchCompute(w / 8, h / 8, 1);
+    // Rounded up, the shaders skip the pixels outside of the image.
+    glDispatchCompute((w + 7) / 8, (h + 7) / 8, 1);
     // Make sure writing to image has finished before read.
     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
 }
 
-void delete_program(Program program) { uninstall_program(program); }
+void delete_program(Program program) {
+    discard_previous_program(program);
+    uninstall_program(program);
+}
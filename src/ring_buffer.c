@@ -0,0 +1,68 @@
+// Required for memfd_create.
+#define _GNU_SOURCE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include "ring_buffer.h"
+
+struct RingBuffer_ {
+    int size;
+    char* data;
+};
+
+RingBuffer create_ring_buffer(int min_size) {
+    int page_size = (int)sysconf(_SC_PAGESIZE);
+    int size = (min_size + page_size - 1) / page_size * page_size;
+
+    // Get some memory that can be mapped more than once.
+    int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+    if(fd == -1) {
+        fprintf(stderr, "Failed to memfd_create\n");
+        exit(1);
+    }
+
+    // Tell the os that we need `size` of memory.
+    if(ftruncate(fd, size) != 0) {
+        fprintf(stderr, "Failed to ftruncate\n");
+        exit(1);
+    }
+
+    // Reserve a contiguous address space of twice the size...
+    char* target = mmap(NULL, 2 * (size_t)size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(target == MAP_FAILED) {
+        fprintf(stderr, "Failed to reserve ring buffer address space\n");
+        exit(1);
+    }
+
+    // ...and map the fd into its first and second half.
+    int prot = PROT_READ | PROT_WRITE;
+    int flags = MAP_SHARED | MAP_FIXED;
+    void* first = mmap(target, (size_t)size, prot, flags, fd, 0);
+    void* second = mmap(target + size, (size_t)size, prot, flags, fd, 0);
+    if(first == MAP_FAILED || second == MAP_FAILED) {
+        fprintf(stderr, "Failed to map ring buffer\n");
+        exit(1);
+    }
+    close(fd);
+
+    RingBuffer ring_buffer = (RingBuffer)malloc(sizeof(struct RingBuffer_));
+    ring_buffer->size = size;
+    ring_buffer->data = target;
+    return ring_buffer;
+}
+
+__attribute__((pure)) int size_of_ring_buffer(RingBuffer ring_buffer) { return ring_buffer->size; }
+
+__attribute__((pure)) void* ring_buffer_at(RingBuffer ring_buffer, uint64_t index) {
+    return ring_buffer->data + index % (uint64_t)ring_buffer->size;
+}
+
+void delete_ring_buffer(RingBuffer ring_buffer) {
+    munmap(ring_buffer->data, 2 * (size_t)ring_buffer->size);
+    free(ring_buffer);
+}
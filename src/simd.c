@@ -0,0 +1,628 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#define SIMD_X86
+#include <immintrin.h>
+#endif
+
+#include "simd.h"
+
+__attribute__((const)) int bytes_per_value(enum SampleFormat format) {
+    switch(format) {
+    case SAMPLE_FORMAT_U8:
+        return 1;
+    case SAMPLE_FORMAT_S16LE:
+        return 2;
+    case SAMPLE_FORMAT_S24LE:
+        return 3;
+    case SAMPLE_FORMAT_S32LE:
+    case SAMPLE_FORMAT_F32LE:
+        return 4;
+    default:
+        fprintf(stderr, "Unknown sample format %d\n", format);
+        exit(1);
+    }
+}
+
+/* SCALAR */
+
+void convert_u8_scalar(uint8_t const* src, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        dst[i] = ((float)src[i] - 128.0f) / 128.0f;
+    }
+}
+
+void convert_s16_scalar(uint8_t const* src, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        uint8_t const* b = src + 2 * i;
+        int16_t value = (int16_t)((uint16_t)b[0] | (uint16_t)(b[1] << 8));
+        dst[i] = (float)value / 32768.0f;
+    }
+}
+
+void convert_s24_scalar(uint8_t const* src, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        uint8_t const* b = src + 3 * i;
+        // Assemble in the upper 3 bytes so that the sign ends up in the right place.
+        int32_t value = (int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 24);
+        dst[i] = (float)(value / 256) / 8388608.0f;
+    }
+}
+
+void convert_s32_scalar(uint8_t const* src, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        uint8_t const* b = src + 4 * i;
+        int32_t value = (int32_t)((uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24);
+        dst[i] = (float)value / 2147483648.0f;
+    }
+}
+
+void deinterleave_channels_scalar(float const* interleaved, int num_channels, float* left, float* right,
+                                  int num_samples) {
+    int right_channel = num_channels > 1 ? 1 : 0;
+    for(int i = 0; i < num_samples; i++) {
+        left[i] = interleaved[num_channels * i];
+        right[i] = interleaved[num_channels * i + right_channel];
+    }
+}
+
+
+void deinterleave_stereo_scalar(float const* interleaved, float* left, float* right, int num_samples) {
+    for(int i = 0; i < num_samples; i++) {
+        left[i] = interleaved[2 * i];
+        right[i] = interleaved[2 * i + 1];
+    }
+}
+
+void multiply_window_scalar(float const* src, float const* window, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        dst[i] = src[i] * window[i];
+    }
+}
+
+void mix_window_scalar(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        dst[i] = 0.5f * (left[i] + right[i]) * window[i];
+    }
+}
+
+void interleave_window_scalar(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        dst[2 * i] = left[i] * window[i];
+        dst[2 * i + 1] = right[i] * window[i];
+    }
+}
+
+// Bins `[first, last)` of a halfcomplex spectrum of `size`, 0 < first <= last <= size / 2.
+void halfcomplex_magnitudes_scalar(float const* halfcomplex, int size, float* magnitudes, int first, int last) {
+    for(int k = first; k < last; k++) {
+        float re = halfcomplex[k];
+        float im = halfcomplex[size - k];
+        magnitudes[k] = sqrtf(re * re + im * im);
+    }
+}
+
+void sparse_matrix_vector_scalar(int num_rows, int const* row_offsets, int const* columns, float const* values,
+                                 float const* x, float* y) {
+    for(int i = 0; i < num_rows; i++) {
+        float sum = 0.0f;
+        for(int j = row_offsets[i]; j < row_offsets[i + 1]; j++) {
+            sum += values[j] * x[columns[j]];
+        }
+        y[i] = sum;
+    }
+}
+
+// Keeps silent bins out of -inf.
+#define LOG2_FLOOR 1e-10f
+
+// Adds bins `first` to `last` to `sums`.
+void spectrum_sums_scalar(float const* magnitudes, float const* previous, int first, int last,
+                          struct SpectrumSums* sums) {
+    for(int k = first; k < last; k++) {
+        float m = magnitudes[k];
+        sums->sum += m;
+        sums->weighted_sum += (float)k * m;
+        sums->square_weighted_sum += (float)k * (float)k * m;
+        sums->log2_sum += log2f(m + LOG2_FLOOR);
+        sums->max = fmaxf(sums->max, m);
+        sums->rectified_flux += fmaxf(0.0f, m - previous[k]);
+    }
+}
+
+#ifdef SIMD_X86
+
+__attribute__((pure)) bool has_avx2(void) { return __builtin_cpu_supports("avx2"); }
+
+/* SSE2 */
+
+void convert_u8_sse2(uint8_t const* src, float* dst, int num_values) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const offset = _mm_set1_epi32(128);
+    __m128 const scale = _mm_set1_ps(1.0f / 128.0f);
+    int i = 0;
+    for(; i + 16 <= num_values; i += 16) {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i quarters[4] = {_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+                               _mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+        for(int q = 0; q < 4; q++) {
+            __m128 f = _mm_cvtepi32_ps(_mm_sub_epi32(quarters[q], offset));
+            _mm_storeu_ps(dst + i + 4 * q, _mm_mul_ps(f, scale));
+        }
+    }
+    convert_u8_scalar(src + i, dst + i, num_values - i);
+}
+
+void convert_s16_sse2(uint8_t const* src, float* dst, int num_values) {
+    __m128 const scale = _mm_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + 2 * i));
+        // Duplicate each value into both halves of a 32 bit lane, shift the sign down.
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    convert_s16_scalar(src + 2 * i, dst + i, num_values - i);
+}
+
+void convert_s32_sse2(uint8_t const* src, float* dst, int num_values) {
+    __m128 const scale = _mm_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+    for(; i + 4 <= num_values; i += 4) {
+        __m128i v = _mm_loadu_si128((__m128i const*)(src + 4 * i));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    convert_s32_scalar(src + 4 * i, dst + i, num_values - i);
+}
+
+void deinterleave_stereo_sse2(float const* interleaved, float* left, float* right, int num_samples) {
+    int i = 0;
+    for(; i + 4 <= num_samples; i += 4) {
+        __m128 a = _mm_loadu_ps(interleaved + 2 * i);     // l0 r0 l1 r1
+        __m128 b = _mm_loadu_ps(interleaved + 2 * i + 4); // l2 r2 l3 r3
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave_stereo_scalar(interleaved + 2 * i, left + i, right + i, num_samples - i);
+}
+
+void multiply_window_sse2(float const* src, float const* window, float* dst, int num_values) {
+    int i = 0;
+    for(; i + 4 <= num_values; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), _mm_loadu_ps(window + i)));
+    }
+    multiply_window_scalar(src + i, window + i, dst + i, num_values - i);
+}
+
+void mix_window_sse2(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    __m128 const half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for(; i + 4 <= num_values; i += 4) {
+        __m128 mid = _mm_mul_ps(half, _mm_add_ps(_mm_loadu_ps(left + i), _mm_loadu_ps(right + i)));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(mid, _mm_loadu_ps(window + i)));
+    }
+    mix_window_scalar(left + i, right + i, window + i, dst + i, num_values - i);
+}
+
+void interleave_window_sse2(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    int i = 0;
+    for(; i + 4 <= num_values; i += 4) {
+        __m128 w = _mm_loadu_ps(window + i);
+        __m128 l = _mm_mul_ps(_mm_loadu_ps(left + i), w);
+        __m128 r = _mm_mul_ps(_mm_loadu_ps(right + i), w);
+        _mm_storeu_ps(dst + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleave_window_scalar(left + i, right + i, window + i, dst + 2 * i, num_values - i);
+}
+
+void halfcomplex_magnitudes_sse2(float const* halfcomplex, int size, float* magnitudes, int first, int last) {
+    int k = first;
+    for(; k + 4 <= last; k += 4) {
+        __m128 re = _mm_loadu_ps(halfcomplex + k);
+        // The imaginary parts are stored backwards from the end.
+        __m128 im = _mm_loadu_ps(halfcomplex + size - k - 3);
+        im = _mm_shuffle_ps(im, im, _MM_SHUFFLE(0, 1, 2, 3));
+        __m128 square = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+        _mm_storeu_ps(magnitudes + k, _mm_sqrt_ps(square));
+    }
+    halfcomplex_magnitudes_scalar(halfcomplex, size, magnitudes, k, last);
+}
+
+// log2 of positive normal floats, exponent plus a polynomial fit of log2(1 + t) on [0, 1).
+__attribute__((const)) __m128 log2_sse2(__m128 x) {
+    __m128i bits = _mm_castps_si128(x);
+    __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128i mantissa = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+    __m128 t = _mm_sub_ps(_mm_castsi128_ps(mantissa), _mm_set1_ps(1.0f));
+    __m128 p = _mm_set1_ps(0.04526829f);
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.19351652f));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.41524556f));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.70886522f));
+    p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.44187990f));
+    return _mm_add_ps(exponent, _mm_mul_ps(p, t));
+}
+
+void spectrum_sums_sse2(float const* magnitudes, float const* previous, int first, int last,
+                        struct SpectrumSums* sums) {
+    __m128 const floor = _mm_set1_ps(LOG2_FLOOR);
+    __m128 const zero = _mm_setzero_ps();
+    __m128 k = _mm_add_ps(_mm_set1_ps((float)first), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    __m128 sum = zero, weighted = zero, square_weighted = zero, log2_sum = zero, max = zero, flux = zero;
+    int i = first;
+    for(; i + 4 <= last; i += 4) {
+        __m128 m = _mm_loadu_ps(magnitudes + i);
+        __m128 km = _mm_mul_ps(k, m);
+        sum = _mm_add_ps(sum, m);
+        weighted = _mm_add_ps(weighted, km);
+        square_weighted = _mm_add_ps(square_weighted, _mm_mul_ps(k, km));
+        log2_sum = _mm_add_ps(log2_sum, log2_sse2(_mm_add_ps(m, floor)));
+        max = _mm_max_ps(max, m);
+        flux = _mm_add_ps(flux, _mm_max_ps(zero, _mm_sub_ps(m, _mm_loadu_ps(previous + i))));
+        k = _mm_add_ps(k, _mm_set1_ps(4.0f));
+    }
+
+    float lanes[6][4];
+    _mm_storeu_ps(lanes[0], sum);
+    _mm_storeu_ps(lanes[1], weighted);
+    _mm_storeu_ps(lanes[2], square_weighted);
+    _mm_storeu_ps(lanes[3], log2_sum);
+    _mm_storeu_ps(lanes[4], max);
+    _mm_storeu_ps(lanes[5], flux);
+    for(int j = 0; j < 4; j++) {
+        sums->sum += lanes[0][j];
+        sums->weighted_sum += lanes[1][j];
+        sums->square_weighted_sum += lanes[2][j];
+        sums->log2_sum += lanes[3][j];
+        sums->max = fmaxf(sums->max, lanes[4][j]);
+        sums->rectified_flux += lanes[5][j];
+    }
+    spectrum_sums_scalar(magnitudes, previous, i, last, sums);
+}
+
+/* AVX2 */
+
+// Every kernel clears the upper halves before falling back to the SSE/scalar
+// tail. GCC doesn't always emit vzeroupper before a tail call, and the dirty
+// state slows down all SSE code afterwards (libm included) by up to 10x.
+
+__attribute__((target("avx2"))) void convert_u8_avx2(uint8_t const* src, float* dst, int num_values) {
+    __m256i const offset = _mm256_set1_epi32(128);
+    __m256 const scale = _mm256_set1_ps(1.0f / 128.0f);
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(src + i)));
+        __m256 f = _mm256_cvtepi32_ps(_mm256_sub_epi32(v, offset));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, scale));
+    }
+    _mm256_zeroupper();
+    convert_u8_scalar(src + i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void convert_s16_avx2(uint8_t const* src, float* dst, int num_values) {
+    __m256 const scale = _mm256_set1_ps(1.0f / 32768.0f);
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const*)(src + 2 * i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    _mm256_zeroupper();
+    convert_s16_scalar(src + 2 * i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void convert_s24_avx2(uint8_t const* src, float* dst, int num_values) {
+    // Each lane gets 4 packed values (12 of its 16 bytes), moved into the upper
+    // 3 bytes of a 32 bit value. -1 zeroes the lowest byte.
+    __m256i const shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, //
+                                             -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+    __m256 const scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+    // The second lane loads 4 bytes past the 8 values, stay clear of the end.
+    for(; i + 10 <= num_values; i += 8) {
+        __m128i lo = _mm_loadu_si128((__m128i const*)(src + 3 * i));
+        __m128i hi = _mm_loadu_si128((__m128i const*)(src + 3 * i + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_shuffle_epi8(v, shuffle);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    _mm256_zeroupper();
+    convert_s24_scalar(src + 3 * i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void convert_s32_avx2(uint8_t const* src, float* dst, int num_values) {
+    __m256 const scale = _mm256_set1_ps(1.0f / 2147483648.0f);
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m256i v = _mm256_loadu_si256((__m256i const*)(src + 4 * i));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    _mm256_zeroupper();
+    convert_s32_scalar(src + 4 * i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void
+deinterleave_stereo_avx2(float const* interleaved, float* left, float* right, int num_samples) {
+    int i = 0;
+    for(; i + 8 <= num_samples; i += 8) {
+        __m256 a = _mm256_loadu_ps(interleaved + 2 * i);     // l0 r0 l1 r1 | l2 r2 l3 r3
+        __m256 b = _mm256_loadu_ps(interleaved + 2 * i + 8); // l4 r4 l5 r5 | l6 r6 l7 r7
+        // In-lane shuffles give l0 l1 l4 l5 | l2 l3 l6 l7, fix the order of the 64 bit pairs.
+        __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        l = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0)));
+        r = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0)));
+        _mm256_storeu_ps(left + i, l);
+        _mm256_storeu_ps(right + i, r);
+    }
+    _mm256_zeroupper();
+    deinterleave_stereo_sse2(interleaved + 2 * i, left + i, right + i, num_samples - i);
+}
+
+__attribute__((target("avx2"))) void
+multiply_window_avx2(float const* src, float const* window, float* dst, int num_values) {
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(window + i)));
+    }
+    _mm256_zeroupper();
+    multiply_window_sse2(src + i, window + i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void
+mix_window_avx2(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    __m256 const half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m256 mid = _mm256_mul_ps(half, _mm256_add_ps(_mm256_loadu_ps(left + i), _mm256_loadu_ps(right + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(mid, _mm256_loadu_ps(window + i)));
+    }
+    _mm256_zeroupper();
+    mix_window_sse2(left + i, right + i, window + i, dst + i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void
+interleave_window_avx2(float const* left, float const* right, float const* window, float* dst, int num_values) {
+    int i = 0;
+    for(; i + 8 <= num_values; i += 8) {
+        __m256 w = _mm256_loadu_ps(window + i);
+        __m256 l = _mm256_mul_ps(_mm256_loadu_ps(left + i), w);
+        __m256 r = _mm256_mul_ps(_mm256_loadu_ps(right + i), w);
+        // In-lane unpacks give l0 r0 l1 r1 | l4 r4 l5 r5 and l2 r2 l3 r3 | l6 r6 l7 r7.
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    _mm256_zeroupper();
+    interleave_window_sse2(left + i, right + i, window + i, dst + 2 * i, num_values - i);
+}
+
+__attribute__((target("avx2"))) void
+halfcomplex_magnitudes_avx2(float const* halfcomplex, int size, float* magnitudes, int first, int last) {
+    __m256i const reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    int k = first;
+    for(; k + 8 <= last; k += 8) {
+        __m256 re = _mm256_loadu_ps(halfcomplex + k);
+        __m256 im = _mm256_permutevar8x32_ps(_mm256_loadu_ps(halfcomplex + size - k - 7), reverse);
+        __m256 square = _mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im));
+        _mm256_storeu_ps(magnitudes + k, _mm256_sqrt_ps(square));
+    }
+    _mm256_zeroupper();
+    halfcomplex_magnitudes_sse2(halfcomplex, size, magnitudes, k, last);
+}
+
+__attribute__((target("avx2"))) void sparse_matrix_vector_avx2(int num_rows, int const* row_offsets,
+                                                               int const* columns, float const* values, float const* x,
+                                                               float* y) {
+    for(int i = 0; i < num_rows; i++) {
+        int j = row_offsets[i];
+        int end = row_offsets[i + 1];
+        __m256 sums = _mm256_setzero_ps();
+        for(; j + 8 <= end; j += 8) {
+            __m256i indices = _mm256_loadu_si256((__m256i const*)(columns + j));
+            __m256 gathered = _mm256_i32gather_ps(x, indices, 4);
+            sums = _mm256_add_ps(sums, _mm256_mul_ps(_mm256_loadu_ps(values + j), gathered));
+        }
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(sums), _mm256_extractf128_ps(sums, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        float sum = _mm_cvtss_f32(half);
+        for(; j < end; j++) {
+            sum += values[j] * x[columns[j]];
+        }
+        y[i] = sum;
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx2"), const)) __m256 log2_avx2(__m256 x) {
+    __m256i bits = _mm256_castps_si256(x);
+    __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+    __m256i mantissa =
+        _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007fffff)), _mm256_set1_epi32(0x3f800000));
+    __m256 t = _mm256_sub_ps(_mm256_castsi256_ps(mantissa), _mm256_set1_ps(1.0f));
+    __m256 p = _mm256_set1_ps(0.04526829f);
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(-0.19351652f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(0.41524556f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(-0.70886522f));
+    p = _mm256_add_ps(_mm256_mul_ps(p, t), _mm256_set1_ps(1.44187990f));
+    return _mm256_add_ps(exponent, _mm256_mul_ps(p, t));
+}
+
+__attribute__((target("avx2"))) void
+spectrum_sums_avx2(float const* magnitudes, float const* previous, int first, int last, struct SpectrumSums* sums) {
+    __m256 const floor = _mm256_set1_ps(LOG2_FLOOR);
+    __m256 const zero = _mm256_setzero_ps();
+    __m256 const lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    __m256 k = _mm256_add_ps(_mm256_set1_ps((float)first), lane);
+    __m256 sum = zero, weighted = zero, square_weighted = zero, log2_sum = zero, max = zero, flux = zero;
+    int i = first;
+    for(; i + 8 <= last; i += 8) {
+        __m256 m = _mm256_loadu_ps(magnitudes + i);
+        __m256 km = _mm256_mul_ps(k, m);
+        sum = _mm256_add_ps(sum, m);
+        weighted = _mm256_add_ps(weighted, km);
+        square_weighted = _mm256_add_ps(square_weighted, _mm256_mul_ps(k, km));
+        log2_sum = _mm256_add_ps(log2_sum, log2_avx2(_mm256_add_ps(m, floor)));
+        max = _mm256_max_ps(max, m);
+        flux = _mm256_add_ps(flux, _mm256_max_ps(zero, _mm256_sub_ps(m, _mm256_loadu_ps(previous + i))));
+        k = _mm256_add_ps(k, _mm256_set1_ps(8.0f));
+    }
+
+    float lanes[6][8];
+    _mm256_storeu_ps(lanes[0], sum);
+    _mm256_storeu_ps(lanes[1], weighted);
+    _mm256_storeu_ps(lanes[2], square_weighted);
+    _mm256_storeu_ps(lanes[3], log2_sum);
+    _mm256_storeu_ps(lanes[4], max);
+    _mm256_storeu_ps(lanes[5], flux);
+    _mm256_zeroupper();
+    for(int j = 0; j < 8; j++) {
+        sums->sum += lanes[0][j];
+        sums->weighted_sum += lanes[1][j];
+        sums->square_weighted_sum += lanes[2][j];
+        sums->log2_sum += lanes[3][j];
+        sums->max = fmaxf(sums->max, lanes[4][j]);
+        sums->rectified_flux += lanes[5][j];
+    }
+    spectrum_sums_sse2(magnitudes, previous, i, last, sums);
+}
+
+#endif
+
+/* DISPATCH */
+
+void convert_to_float(enum SampleFormat format, void const* src, float* dst, int num_values) {
+    uint8_t const* bytes = (uint8_t const*)src;
+#ifdef SIMD_X86
+    bool avx2 = has_avx2();
+    switch(format) {
+    case SAMPLE_FORMAT_U8:
+        (avx2 ? convert_u8_avx2 : convert_u8_sse2)(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S16LE:
+        (avx2 ? convert_s16_avx2 : convert_s16_sse2)(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S24LE:
+        (avx2 ? convert_s24_avx2 : convert_s24_scalar)(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S32LE:
+        (avx2 ? convert_s32_avx2 : convert_s32_sse2)(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_F32LE:
+        memcpy(dst, src, (size_t)num_values * sizeof(float));
+        break;
+    default:
+        fprintf(stderr, "Unknown sample format %d\n", format);
+        exit(1);
+    }
+#else
+    switch(format) {
+    case SAMPLE_FORMAT_U8:
+        convert_u8_scalar(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S16LE:
+        convert_s16_scalar(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S24LE:
+        convert_s24_scalar(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_S32LE:
+        convert_s32_scalar(bytes, dst, num_values);
+        break;
+    case SAMPLE_FORMAT_F32LE:
+        memcpy(dst, src, (size_t)num_values * sizeof(float));
+        break;
+    default:
+        fprintf(stderr, "Unknown sample format %d\n", format);
+        exit(1);
+    }
+#endif
+}
+
+void deinterleave_stereo(float const* interleaved, float* left, float* right, int num_samples) {
+#ifdef SIMD_X86
+    if(has_avx2()) {
+        deinterleave_stereo_avx2(interleaved, left, right, num_samples);
+    } else {
+        deinterleave_stereo_sse2(interleaved, left, right, num_samples);
+    }
+#else
+    deinterleave_stereo_scalar(interleaved, left, right, num_samples);
+#endif
+}
+
+void deinterleave_channels(float const* interleaved, int num_channels, float* left, float* right, int num_samples) {
+    if(num_channels == 2) {
+        deinterleave_stereo(interleaved, left, right, num_samples);
+    } else if(num_channels == 1) {
+        memcpy(left, interleaved, (size_t)num_samples * sizeof(float));
+        memcpy(right, interleaved, (size_t)num_samples * sizeof(float));
+    } else {
+        deinterleave_channels_scalar(interleaved, num_channels, left, right, num_samples);
+    }
+}
+
+void multiply_window(float const* src, float const* window, float* dst, int num_values) {
+#ifdef SIMD_X86
+    (has_avx2() ? multiply_window_avx2 : multiply_window_sse2)(src, window, dst, num_values);
+#else
+    multiply_window_scalar(src, window, dst, num_values);
+#endif
+}
+
+void halfcomplex_magnitudes(float const* halfcomplex, int size, float* magnitudes) {
+    // DC and Nyquist have no imaginary part.
+    magnitudes[0] = fabsf(halfcomplex[0]);
+    magnitudes[size / 2] = fabsf(halfcomplex[size / 2]);
+#ifdef SIMD_X86
+    (has_avx2() ? halfcomplex_magnitudes_avx2 : halfcomplex_magnitudes_sse2)(halfcomplex, size, magnitudes, 1,
+                                                                              size / 2);
+#else
+    halfcomplex_magnitudes_scalar(halfcomplex, size, magnitudes, 1, size / 2);
+#endif
+}
+
+void mix_window(float const* left, float const* right, float const* window, float* dst, int num_values) {
+#ifdef SIMD_X86
+    (has_avx2() ? mix_window_avx2 : mix_window_sse2)(left, right, window, dst, num_values);
+#else
+    mix_window_scalar(left, right, window, dst, num_values);
+#endif
+}
+
+void interleave_window(float const* left, float const* right, float const* window, float* dst, int num_values) {
+#ifdef SIMD_X86
+    (has_avx2() ? interleave_window_avx2 : interleave_window_sse2)(left, right, window, dst, num_values);
+#else
+    interleave_window_scalar(left, right, window, dst, num_values);
+#endif
+}
+
+void sparse_matrix_vector(int num_rows, int const* row_offsets, int const* columns, float const* values, float const* x,
+                          float* y) {
+#ifdef SIMD_X86
+    (has_avx2() ? sparse_matrix_vector_avx2 : sparse_matrix_vector_scalar)(num_rows, row_offsets, columns, values, x,
+                                                                            y);
+#else
+    sparse_matrix_vector_scalar(num_rows, row_offsets, columns, values, x, y);
+#endif
+}
+
+void spectrum_sums(float const* magnitudes, float const* previous, int num_values, struct SpectrumSums* sums) {
+    *sums = (struct SpectrumSums){0};
+#ifdef SIMD_X86
+    (has_avx2() ? spectrum_sums_avx2 : spectrum_sums_sse2)(magnitudes, previous, 0, num_values, sums);
+#else
+    spectrum_sums_scalar(magnitudes, previous, 0, num_values, sums);
+#endif
+}
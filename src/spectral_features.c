@@ -0,0 +1,41 @@
+#include <math.h>
+
+#include "globals.h"
+#include "simd.h"
+#include "spectral_features.h"
+
+#define ROLLOFF_FRACTION 0.85f
+
+void compute_spectral_features(float const* magnitudes, float const* previous, int num_bins, float bin_hz,
+                               struct SpectralFeatures* features) {
+    struct SpectrumSums sums;
+    spectrum_sums(magnitudes, previous, num_bins, &sums);
+
+    features->flux = sums.rectified_flux;
+    if(sums.sum <= 0.0f) {
+        // Silence has no shape.
+        features->centroid = 0.0f;
+        features->spread = 0.0f;
+        features->rolloff = 0.0f;
+        features->flatness = 0.0f;
+        features->crest = 0.0f;
+        return;
+    }
+
+    float mean = sums.sum / (float)num_bins;
+    float centroid = sums.weighted_sum / sums.sum;
+    float variance = sums.square_weighted_sum / sums.sum - centroid * centroid;
+    features->centroid = centroid * bin_hz;
+    features->spread = sqrtf(MAX(0.0f, variance)) * bin_hz;
+    features->flatness = MIN(1.0f, exp2f(sums.log2_sum / (float)num_bins) / mean);
+    features->crest = sums.max / mean;
+
+    // Mostly ends early, the energy sits in the bass.
+    float threshold = ROLLOFF_FRACTION * sums.sum;
+    float cumulative = 0.0f;
+    int bin = 0;
+    while(bin < num_bins - 1 && (cumulative += magnitudes[bin]) < threshold) {
+        bin++;
+    }
+    features->rolloff = (float)bin * bin_hz;
+}
@@ -0,0 +1,122 @@
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <SDL2/SDL_opengl.h>
+#include <SDL2/SDL_opengl_glext.h>
+
+#include "buffers.h"
+#include "globals.h"
+#include "spectrogram.h"
+
+struct Spectrogram_ {
+    int num_bins;
+    int num_rows;
+    // Rows ever added and uploaded, a row goes to `count % num_rows`. Adding may
+    // happen on another thread than uploading, the release/acquire on
+    // `num_added_rows` publishes the rows before it.
+    _Atomic uint64_t num_added_rows;
+    uint64_t num_uploaded_rows;
+
+    // CPU copy of the texture, so that an upload is one or two sub-images.
+    float* rows;
+
+    GLuint texture;
+    GLenum texture_unit;
+
+    // Layout of the `spectrogram_data` block.
+    struct {
+        int row;
+        int rows;
+        int bins;
+        float bin_hz;
+    } data;
+    Buffer buffer;
+};
+
+Spectrogram create_spectrogram(DftData dft_data, int num_rows, unsigned int index, unsigned int texture_unit) {
+    Spectrogram spectrogram = ALLOCATE(1, struct Spectrogram_);
+    int num_bins = size_of_dft(dft_data) / 2 + 1;
+    spectrogram->num_bins = num_bins;
+    spectrogram->num_rows = num_rows;
+    atomic_init(&spectrogram->num_added_rows, 0);
+    spectrogram->num_uploaded_rows = 0;
+    spectrogram->rows = ALLOCATE(num_rows * num_bins, float);
+    memset(spectrogram->rows, 0, (size_t)(num_rows * num_bins) * sizeof(float));
+
+    // Half floats are plenty for magnitudes and halve the upload, GL converts.
+    spectrogram->texture_unit = GL_TEXTURE0 + texture_unit;
+    glActiveTexture(spectrogram->texture_unit);
+    glGenTextures(1, &spectrogram->texture);
+    glBindTexture(GL_TEXTURE_2D, spectrogram->texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, num_bins, num_rows, 0, GL_RED, GL_FLOAT, spectrogram->rows);
+    // Stays bound, the texture units besides 0 are ours.
+    glActiveTexture(GL_TEXTURE0);
+
+    spectrogram->data.row = 0;
+    spectrogram->data.rows = num_rows;
+    spectrogram->data.bins = num_bins;
+    spectrogram->data.bin_hz = (float)sample_rate_of_dft(dft_data) / (float)size_of_dft(dft_data);
+    spectrogram->buffer = create_streaming_uniform_buffer(isizeof(spectrogram->data), index);
+    copy_buffer_to_gpu(spectrogram->buffer, &spectrogram->data, 0, isizeof(spectrogram->data));
+    commit_buffer_to_gpu(spectrogram->buffer);
+
+    return spectrogram;
+}
+
+void add_spectrogram_rows(Spectrogram spectrogram, DftData dft_data, int num_frames) {
+    size_t row_size = (size_t)spectrogram->num_bins * sizeof(float);
+    uint64_t num_rows = atomic_load_explicit(&spectrogram->num_added_rows, memory_order_relaxed);
+    // Only the newest rows matter if there are more than fit.
+    FORI(MAX(0, num_frames - spectrogram->num_rows), num_frames) {
+        float* row = spectrogram->rows + (num_rows % (uint64_t)spectrogram->num_rows) * (uint64_t)spectrogram->num_bins;
+        memcpy(row, queued_magnitudes_of_dft(dft_data, i), row_size);
+        num_rows++;
+    }
+    atomic_store_explicit(&spectrogram->num_added_rows, num_rows, memory_order_release);
+}
+
+void copy_spectrogram_rows_to_gpu(Spectrogram spectrogram, int first, int num_rows) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, spectrogram->num_bins, num_rows, GL_RED, GL_FLOAT,
+                    spectrogram->rows + first * spectrogram->num_bins);
+}
+
+void copy_spectrogram_to_gpu(Spectrogram spectrogram) {
+    uint64_t num_added_rows = atomic_load_explicit(&spectrogram->num_added_rows, memory_order_acquire);
+    if(num_added_rows == spectrogram->num_uploaded_rows) {
+        return;
+    }
+
+    // A concurrent writer would have to add a whole ring minus these rows during
+    // the upload to overwrite any of them, a few rows per frame are the norm.
+    int num_dirty_rows = (int)MIN(num_added_rows - spectrogram->num_uploaded_rows, (uint64_t)spectrogram->num_rows);
+    int row = (int)(num_added_rows % (uint64_t)spectrogram->num_rows);
+    int first = row - num_dirty_rows;
+    glActiveTexture(spectrogram->texture_unit);
+    if(first < 0) {
+        copy_spectrogram_rows_to_gpu(spectrogram, spectrogram->num_rows + first, -first);
+        copy_spectrogram_rows_to_gpu(spectrogram, 0, row);
+    } else {
+        copy_spectrogram_rows_to_gpu(spectrogram, first, num_dirty_rows);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    spectrogram->num_uploaded_rows = num_added_rows;
+
+    spectrogram->data.row = row;
+    copy_buffer_to_gpu(spectrogram->buffer, &spectrogram->data.row, 0, isizeof(int));
+    commit_buffer_to_gpu(spectrogram->buffer);
+}
+
+void delete_spectrogram(Spectrogram spectrogram) {
+    delete_buffer(spectrogram->buffer);
+    glDeleteTextures(1, &spectrogram->texture);
+    free(spectrogram->rows);
+    free(spectrogram);
+}
@@ -0,0 +1,204 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "tempo.h"
+
+#define TEMPO_MIN_BPM 60.0f
+#define TEMPO_MAX_BPM 200.0f
+// Time constant of the autocorrelation, the window it effectively looks at.
+#define TEMPO_WINDOW_S 4.0f
+// Time constant of the onset mean that gets removed.
+#define TEMPO_MEAN_S 1.0f
+// Tempos far from this are less likely, which settles most octave errors.
+#define TEMPO_PRIOR_BPM 120.0f
+#define TEMPO_PRIOR_OCTAVES 1.0f
+// A different period has to score this much better for this long to take over.
+#define TEMPO_SWITCH_RATIO 1.15f
+#define TEMPO_SWITCH_S 1.0f
+// How hard a strong onset pulls the phase towards the beat.
+#define TEMPO_PHASE_GAIN 0.05f
+
+struct Tempo_ {
+    float hops_per_s;
+    // Candidate periods in hops, inclusive.
+    int min_lag;
+    int max_lag;
+    int num_lags;
+
+    float decay;
+    float mean_rate;
+    float onset_mean;
+
+    // The last `max_lag + 1` mean free onsets, the newest at `num_hops - 1`.
+    float* onsets;
+    int num_onsets;
+    uint64_t num_hops;
+
+    // Leaky autocorrelation of the onsets: lag 0 and `min_lag` to `max_lag`.
+    // Updated per hop, old hops fade out instead of dropping out of a window.
+    float energy;
+    float* autocorrelation;
+    float* weights;
+
+    // Tracked period in hops, 0 before the first estimate.
+    float lag;
+    int switch_hops;
+    float phase;
+};
+
+Tempo create_tempo(int sample_rate, int hop_size) {
+    Tempo tempo = ALLOCATE(1, struct Tempo_);
+    float hops_per_s = (float)sample_rate / (float)hop_size;
+    tempo->hops_per_s = hops_per_s;
+    tempo->min_lag = MAX(1, (int)floorf(60.0f * hops_per_s / TEMPO_MAX_BPM));
+    tempo->max_lag = MAX(tempo->min_lag + 2, (int)ceilf(60.0f * hops_per_s / TEMPO_MIN_BPM));
+    tempo->num_lags = tempo->max_lag - tempo->min_lag + 1;
+
+    tempo->decay = expf(-1.0f / (TEMPO_WINDOW_S * hops_per_s));
+    tempo->mean_rate = 1.0f - expf(-1.0f / (TEMPO_MEAN_S * hops_per_s));
+    tempo->onset_mean = 0.0f;
+
+    tempo->num_onsets = tempo->max_lag + 1;
+    tempo->onsets = ALLOCATE(tempo->num_onsets, float);
+    memset(tempo->onsets, 0, (size_t)tempo->num_onsets * sizeof(float));
+    tempo->num_hops = 0;
+
+    tempo->energy = 0.0f;
+    tempo->autocorrelation = ALLOCATE(tempo->num_lags, float);
+    memset(tempo->autocorrelation, 0, (size_t)tempo->num_lags * sizeof(float));
+    tempo->weights = ALLOCATE(tempo->num_lags, float);
+    FORI(0, tempo->num_lags) {
+        float bpm = 60.0f * hops_per_s / (float)(tempo->min_lag + i);
+        float octaves = log2f(bpm / TEMPO_PRIOR_BPM) / TEMPO_PRIOR_OCTAVES;
+        tempo->weights[i] = expf(-0.5f * octaves * octaves);
+    }
+
+    tempo->lag = 0.0f;
+    tempo->switch_hops = 0;
+    tempo->phase = 0.0f;
+
+    return tempo;
+}
+
+void update_autocorrelation(Tempo tempo, float onset) {
+    int newest = (int)(tempo->num_hops % (uint64_t)tempo->num_onsets);
+    tempo->onsets[newest] = onset;
+    tempo->num_hops++;
+
+    tempo->energy = tempo->decay * tempo->energy + onset * onset;
+    FORI(0, tempo->num_lags) {
+        int past = newest - (tempo->min_lag + i);
+        past += past < 0 ? tempo->num_onsets : 0;
+        tempo->autocorrelation[i] = tempo->decay * tempo->autocorrelation[i] + onset * tempo->onsets[past];
+    }
+}
+
+// Best weighted period in hops, refined between lags by a parabola through the neighbours.
+float best_lag(Tempo tempo, float* best_score) {
+    int best = 0;
+    *best_score = -INFINITY;
+    FORI(0, tempo->num_lags) {
+        float score = tempo->autocorrelation[i] * tempo->weights[i];
+        if(score > *best_score) {
+            *best_score = score;
+            best = i;
+        }
+    }
+
+    float offset = 0.0f;
+    if(best > 0 && best < tempo->num_lags - 1) {
+        float before = tempo->autocorrelation[best - 1];
+        float peak = tempo->autocorrelation[best];
+        float after = tempo->autocorrelation[best + 1];
+        float curvature = before - 2.0f * peak + after;
+        if(curvature < 0.0f) {
+            offset = CLAMP(0.5f * (before - after) / curvature, -0.5f, 0.5f);
+        }
+    }
+    return (float)(tempo->min_lag + best) + offset;
+}
+
+__attribute__((pure)) int lag_index(Tempo tempo, float lag) {
+    return CLAMP((int)roundf(lag) - tempo->min_lag, 0, tempo->num_lags - 1);
+}
+
+// Onsets a fractional period apart split their correlation between the lags around it.
+__attribute__((pure)) float correlation_at_lag(Tempo tempo, float lag) {
+    int below = CLAMP((int)floorf(lag) - tempo->min_lag, 0, tempo->num_lags - 1);
+    int above = MIN(below + 1, tempo->num_lags - 1);
+    float correlation = MAX(tempo->autocorrelation[below], 0.0f);
+    return above == below ? correlation : correlation + MAX(tempo->autocorrelation[above], 0.0f);
+}
+
+void track_lag(Tempo tempo) {
+    float best_score;
+    float candidate = best_lag(tempo, &best_score);
+    if(tempo->lag <= 0.0f) {
+        tempo->lag = candidate;
+        return;
+    }
+
+    // Follow small drifts right away, but only jump after a sustained better match.
+    if(fabsf(candidate - tempo->lag) <= 1.0f) {
+        tempo->lag = mix(tempo->lag, candidate, 0.05f);
+        tempo->switch_hops = 0;
+        return;
+    }
+    int current = lag_index(tempo, tempo->lag);
+    float current_score = tempo->autocorrelation[current] * tempo->weights[current];
+    if(best_score > TEMPO_SWITCH_RATIO * current_score) {
+        tempo->switch_hops++;
+    } else {
+        tempo->switch_hops = 0;
+    }
+    if((float)tempo->switch_hops >= TEMPO_SWITCH_S * tempo->hops_per_s) {
+        tempo->lag = candidate;
+        tempo->switch_hops = 0;
+    }
+}
+
+void track_phase(Tempo tempo, float onset) {
+    tempo->phase += 1.0f / tempo->lag;
+    tempo->phase -= floorf(tempo->phase);
+
+    // Onsets mark the beat, pull the phase towards 0 in proportion to their strength.
+    float rms = sqrtf(tempo->energy * (1.0f - tempo->decay));
+    if(onset > 0.0f && rms > 0.0f) {
+        float error = tempo->phase < 0.5f ? tempo->phase : tempo->phase - 1.0f;
+        float strength = MIN(onset / rms, 2.0f);
+        tempo->phase -= TEMPO_PHASE_GAIN * strength * error;
+        tempo->phase -= floorf(tempo->phase);
+    }
+}
+
+void add_tempo_onset(Tempo tempo, float onset, struct TempoEstimate* estimate) {
+    // Compressed, loud broadband hits like snares on every other beat would
+    // otherwise outweigh the kicks and halve the tempo.
+    onset = log1pf(MAX(onset, 0.0f));
+    tempo->onset_mean = mix(tempo->onset_mean, onset, tempo->mean_rate);
+    float centered = onset - tempo->onset_mean;
+    update_autocorrelation(tempo, centered);
+
+    if(tempo->energy <= 0.0f || tempo->num_hops <= (uint64_t)tempo->max_lag) {
+        // Silence or not a whole period yet.
+        estimate->confidence = 0.0f;
+        return;
+    }
+
+    track_lag(tempo);
+    track_phase(tempo, centered);
+
+    estimate->bpm = 60.0f * tempo->hops_per_s / tempo->lag;
+    estimate->phase = tempo->phase;
+    estimate->confidence = CLAMP(correlation_at_lag(tempo, tempo->lag) / tempo->energy, 0.0f, 1.0f);
+}
+
+void delete_tempo(Tempo tempo) {
+    free(tempo->weights);
+    free(tempo->autocorrelation);
+    free(tempo->onsets);
+    free(tempo);
+}
@@ -1,6 +1,7 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define GL_GLEXT_PROTOTYPES
 
@@ -14,42 +15,65 @@
 #include "window.h"
 
 struct Textures_ {
-    // Output texture will be shown on-screen.
-    GLuint present;
-
-    // Auxiliary textures.
-    GLuint back_a;
-    GLuint front_a;
-    GLuint back_b;
-    GLuint front_b;
-    GLuint back_c;
-    GLuint front_c;
+    // `images[IMAGE_PRESENT]` will be shown on-screen, the others are auxiliary.
+    // 0 for the images that aren't used.
+    GLuint images[NUM_IMAGES];
+    struct ImageFormats image_formats;
 
     struct Size size;
 };
 
-void init_tex_params(GLuint texture, struct Size size) {
+// The back images are odd, their front image follows.
+__attribute__((const)) enum Image pair_of_image(enum Image image) {
+    if(image == IMAGE_PRESENT) {
+        return image;
+    }
+    return image % 2 == 1 ? image + 1 : image - 1;
+}
+
+bool add_image_format(struct ImageFormats* image_formats, enum Image image, GLenum format) {
+    GLenum* formats = image_formats->formats;
+    enum Image pair = pair_of_image(image);
+    if((formats[image] != 0 && formats[image] != format) || (formats[pair] != 0 && formats[pair] != format)) {
+        return false;
+    }
+    formats[image] = format;
+    formats[pair] = format;
+    return true;
+}
+
+void init_tex_params(GLuint texture, GLenum format, struct Size size) {
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, size.w, size.h, 0, GL_RGBA, GL_FLOAT, NULL);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, size.w, size.h);
 }
 
 void initialize_textures(Textures textures) {
-    // Just hope for the best lol.
-    GLuint* t = &textures->present;
-    glGenTextures(7, t);
-    FORI(0, 7) {
-        init_tex_params(t[i], textures->size);
+    FORI(0, NUM_IMAGES) {
+        textures->images[i] = 0;
+        if(textures->image_formats.formats[i] != 0) {
+            glGenTextures(1, textures->images + i);
+            init_tex_params(textures->images[i], textures->image_formats.formats[i], textures->size);
+        }
     }
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-Textures create_textures(struct Size size) {
+void set_image_formats(Textures textures, struct ImageFormats const* image_formats) {
+    textures->image_formats = *image_formats;
+    // Something has to be displayed, even if no shader writes it.
+    if(textures->image_formats.formats[IMAGE_PRESENT] == 0) {
+        textures->image_formats.formats[IMAGE_PRESENT] = GL_RGBA32F;
+    }
+}
+
+Textures create_textures(struct Size size, struct ImageFormats const* image_formats) {
     Textures textures = (Textures)malloc(sizeof(struct Textures_));
     textures->size = size;
+    set_image_formats(textures, image_formats);
     initialize_textures(textures);
     return textures;
 }
@@ -57,8 +81,11 @@ Textures create_textures(struct Size size) {
 __attribute__((pure)) struct Size get_texture_size(Textures textures) { return textures->size; }
 
 void deinitialize_textures(Textures textures) {
-    // Just hope for the best again rofl.
-    glDeleteTextures(3, &textures->present);
+    FORI(0, NUM_IMAGES) {
+        if(textures->images[i] != 0) {
+            glDeleteTextures(1, textures->images + i);
+        }
+    }
 }
 
 void delete_textures(Textures textures) {
@@ -72,6 +99,16 @@ void update_textures_window_size(Textures textures, struct Size size) {
     initialize_textures(textures);
 }
 
+void update_texture_formats(Textures textures, struct ImageFormats const* image_formats) {
+    struct ImageFormats previous = textures->image_formats;
+    set_image_formats(textures, image_formats);
+    if(memcmp(&previous, &textures->image_formats, sizeof(previous)) == 0) {
+        return;
+    }
+    deinitialize_textures(textures);
+    initialize_textures(textures);
+}
+
 void swap(GLuint* a, GLuint* b) {
     GLuint tmp = *a;
     *a = *b;
@@ -79,17 +116,17 @@ void swap(GLuint* a, GLuint* b) {
 }
 
 void swap_and_bind_textures(Textures textures) {
-    swap(&textures->back_a, &textures->front_a);
-    swap(&textures->back_b, &textures->front_b);
-    swap(&textures->back_c, &textures->front_c);
-
-    glBindImageTexture(0, textures->present, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-    glBindImageTexture(1, textures->back_a, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glBindImageTexture(2, textures->front_a, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glBindImageTexture(3, textures->back_b, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glBindImageTexture(4, textures->front_b, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glBindImageTexture(5, textures->back_c, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-    glBindImageTexture(6, textures->front_c, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+    GLuint* images = textures->images;
+    swap(images + IMAGE_BACK_A, images + IMAGE_FRONT_A);
+    swap(images + IMAGE_BACK_B, images + IMAGE_FRONT_B);
+    swap(images + IMAGE_BACK_C, images + IMAGE_FRONT_C);
+
+    FORI(0, NUM_IMAGES) {
+        if(images[i] != 0) {
+            // Present is read too when interleaved rendering fills in the skipped pixels.
+            glBindImageTexture((GLuint)i, images[i], 0, GL_FALSE, 0, GL_READ_WRITE, textures->image_formats.formats[i]);
+        }
+    }
 }
 
-__attribute__((pure)) GLuint get_present_texture(Textures textures) { return textures->present; }
+__attribute__((pure)) GLuint get_present_texture(Textures textures) { return textures->images[IMAGE_PRESENT]; }
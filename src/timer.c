@@ -10,7 +10,7 @@ struct Timer_ {
 
 Timer create_timer(unsigned int index) {
     Timer timer = (Timer)malloc(sizeof(struct Timer_));
-    timer->buffer = create_uniform_buffer(sizeof(float), index);
+    timer->buffer = create_streaming_uniform_buffer(sizeof(float), index);
     return timer;
 }
 
@@ -18,6 +18,7 @@ void copy_timer_to_gpu(Timer timer) {
     long current_time = clock();
     float seconds = (float)current_time / CLOCKS_PER_SEC;
     copy_buffer_to_gpu(timer->buffer, &seconds, 0, sizeof(float));
+    commit_buffer_to_gpu(timer->buffer);
 }
 
 void delete_timer(Timer timer) {
@@ -49,7 +49,7 @@ Window create_window(struct Size size) {
     return window;
 }
 
-void display_texture(Window window, GLuint texture, struct Size size) {
+void display_texture(Window window, GLuint texture, struct Size texture_size, struct Size size) {
     // Textures cannot be bound to the default frame buffer, therefore this
     // complex wrangler. For reference see:
     // https://stackoverflow.com/questions/21469784/is-it-possible-to-attach-textures-as-render-target-to-the-default-framebuffer
@@ -60,9 +60,10 @@ void display_texture(Window window, GLuint texture, struct Size size) {
     // Clearing technically not necessary because we recompute (blit) the entire frame each time.
     // glClear(GL_COLOR_BUFFER_BIT);
     // Blit (copy) the tmp framebuffer (current READ) to the output framebuffer (0, default DRAW).
-    int w = size.w;
-    int h = size.h;
-    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    // Rendered at a lower resolution, the blit scales it up.
+    bool scaled = texture_size.w != size.w || texture_size.h != size.h;
+    glBlitFramebuffer(0, 0, texture_size.w, texture_size.h, 0, 0, size.w, size.h, GL_COLOR_BUFFER_BIT,
+                      scaled ? GL_LINEAR : GL_NEAREST);
     // Actually swap real back and front buffers.
     SDL_GL_SwapWindow(window->window);
 }
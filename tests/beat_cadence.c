@@ -0,0 +1,196 @@
+// The beat detection and tempo tracking advance per hop of audio, so feeding
+// the same input at 30 and at 240 frames per second has to give identical
+// results for every hop.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analysis.h"
+#include "globals.h"
+
+#define SAMPLE_RATE 44100
+#define SECONDS 20
+#define HOP_SIZE 512
+#define MAX_BEAT_FREQUENCIES 16
+#define MAX_EVENTS 4096
+
+// What the shaders and the headless binary see of the beats after one hop.
+struct HopResult {
+    uint64_t sample_index;
+    int is_beat;
+    int beats;
+    int bpm;
+    struct TempoEstimate tempo;
+    struct BeatState beat_states[MAX_BEAT_FREQUENCIES];
+};
+
+struct Run {
+    int num_hops;
+    struct HopResult* hops;
+    int num_events;
+    struct BeatEvent events[MAX_EVENTS];
+};
+
+// 120 bpm: a kick on every beat, a noise snare on 2 and 4, hi-hats on the
+// eighths and a bass line. Deterministic, it's generated the same every time.
+float* create_beat_track(int num_samples) {
+    float* interleaved = ALLOCATE(2 * num_samples, float);
+    int const samples_per_beat = SAMPLE_RATE / 2;
+    uint32_t noise = 2463534242u;
+    float kick_phase = 0.0f;
+    float bass_phase = 0.0f;
+    FORI(0, num_samples) {
+        int beat = i / samples_per_beat;
+        float t = (float)(i % samples_per_beat) / (float)SAMPLE_RATE;
+        float eighth_t = (float)(i % (samples_per_beat / 2)) / (float)SAMPLE_RATE;
+
+        noise ^= noise << 13;
+        noise ^= noise >> 17;
+        noise ^= noise << 5;
+        float white = (float)noise / (float)UINT32_MAX * 2.0f - 1.0f;
+
+        // The kick sweeps down from 150 to 50 Hz.
+        kick_phase += 2.0f * PI * (50.0f + 100.0f * expf(-t * 30.0f)) / (float)SAMPLE_RATE;
+        float kick = sinf(kick_phase) * expf(-t * 8.0f);
+        float snare = beat % 2 == 1 ? 0.4f * white * expf(-t * 20.0f) : 0.0f;
+        float hihat = 0.1f * white * expf(-eighth_t * 80.0f);
+        float bass_hz = beat % 8 < 4 ? 55.0f : 73.4f;
+        bass_phase += 2.0f * PI * bass_hz / (float)SAMPLE_RATE;
+        float bass = 0.2f * sinf(bass_phase);
+
+        float mid = 0.6f * kick + snare + bass;
+        interleaved[2 * i] = mid + hihat;
+        interleaved[2 * i + 1] = mid - hihat;
+    }
+    return interleaved;
+}
+
+// Feeds the track `samples_per_frame` at a time, like the render loop does at
+// `SAMPLE_RATE / samples_per_frame` frames per second.
+void run_analysis(float const* interleaved, int num_samples, int samples_per_frame, struct Run* run) {
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = SAMPLE_RATE};
+    Pcm pcm = create_pcm(4 * SAMPLE_RATE, format, 0);
+    DftData dft_data = create_dft_data(4096, HOP_SIZE, SAMPLE_RATE, false, DFT_PLANNING_ESTIMATE, 0);
+    Cqt cqt = create_cqt(dft_data, 24, 30.0f, DFT_PLANNING_ESTIMATE, 0);
+    Filterbank filterbank = create_filterbank(dft_data, 64, FILTERBANK_MEL, 30.0f, 16000.0f, 0);
+    BeatEvents beat_events = create_beat_events(64, 0);
+    struct BandLayout band_layout = default_band_layout();
+    Analysis analysis = create_analysis(dft_data, cqt, filterbank, beat_events, &band_layout, 0);
+
+    int num_beat_frequencies = num_beat_frequencies_of_analysis(analysis);
+    if(num_beat_frequencies > MAX_BEAT_FREQUENCIES) {
+        fprintf(stderr, "FAIL: %d beat frequencies, the test keeps %d\n", num_beat_frequencies,
+                MAX_BEAT_FREQUENCIES);
+        exit(1);
+    }
+
+    run->num_hops = 0;
+    run->hops = ALLOCATE(num_samples / HOP_SIZE + 1, struct HopResult);
+    run->num_events = 0;
+    for(int offset = 0; offset < num_samples; offset += samples_per_frame) {
+        write_pcm_samples(pcm, interleaved + 2 * offset, MIN(samples_per_frame, num_samples - offset));
+        compute_dft_frames(pcm, dft_data);
+        while(next_dft_frame(dft_data)) {
+            analyze_dft_frame(pcm, dft_data, analysis);
+
+            struct GpuData const* data = gpu_data_of_analysis(analysis);
+            struct HopResult* hop = run->hops + run->num_hops++;
+            memset(hop, 0, sizeof(*hop));
+            hop->sample_index = sample_index_of_dft(dft_data);
+            hop->is_beat = data->is_beat;
+            hop->beats = data->beats;
+            hop->bpm = data->bpm;
+            hop->tempo = data->tempo;
+            FORI(0, num_beat_frequencies) {
+                hop->beat_states[i] = beat_state_of_analysis(analysis, i);
+            }
+
+            struct BeatEvent event;
+            while(pop_beat_event(beat_events, &event) && run->num_events < MAX_EVENTS) {
+                run->events[run->num_events++] = event;
+            }
+        }
+    }
+
+    delete_analysis(analysis);
+    delete_beat_events(beat_events);
+    delete_filterbank(filterbank);
+    delete_cqt(cqt);
+    delete_dft_data(dft_data);
+    delete_pcm(pcm);
+}
+
+// Compares the fields one by one, padding in `BeatState` would make memcmp flaky.
+__attribute__((pure)) bool same_hop(struct HopResult const* a, struct HopResult const* b) {
+    bool same = a->sample_index == b->sample_index && a->is_beat == b->is_beat && a->beats == b->beats &&
+                a->bpm == b->bpm && memcmp(&a->tempo, &b->tempo, sizeof(a->tempo)) == 0;
+    FORI(0, MAX_BEAT_FREQUENCIES) {
+        struct BeatState const* x = a->beat_states + i;
+        struct BeatState const* y = b->beat_states + i;
+        same = same && x->hz == y->hz && x->cqt_index == y->cqt_index && x->is_beat == y->is_beat &&
+               memcmp(&x->noise_threshold, &y->noise_threshold, sizeof(float)) == 0 &&
+               memcmp(&x->short_average, &y->short_average, sizeof(float)) == 0 &&
+               memcmp(&x->beat_threshold, &y->beat_threshold, sizeof(float)) == 0 &&
+               memcmp(&x->current, &y->current, sizeof(float)) == 0 &&
+               memcmp(&x->sd_threshold, &y->sd_threshold, sizeof(float)) == 0;
+    }
+    return same;
+}
+
+__attribute__((pure)) bool same_event(struct BeatEvent const* a, struct BeatEvent const* b) {
+    return a->sample_index == b->sample_index && a->band == b->band &&
+           memcmp(&a->strength, &b->strength, sizeof(float)) == 0;
+}
+
+int main(void) {
+    int const num_samples = SECONDS * SAMPLE_RATE;
+    float* interleaved = create_beat_track(num_samples);
+
+    static struct Run slow;
+    static struct Run fast;
+    run_analysis(interleaved, num_samples, SAMPLE_RATE / 30, &slow);
+    run_analysis(interleaved, num_samples, SAMPLE_RATE / 240, &fast);
+
+    int failures = 0;
+    if(slow.num_hops != fast.num_hops) {
+        fprintf(stderr, "FAIL: %d hops at 30 fps, %d at 240 fps\n", slow.num_hops, fast.num_hops);
+        failures++;
+    }
+    FORI(0, MIN(slow.num_hops, fast.num_hops)) {
+        if(!same_hop(slow.hops + i, fast.hops + i)) {
+            fprintf(stderr, "FAIL: hop %d (sample %llu) differs between 30 and 240 fps\n", i,
+                    (unsigned long long)slow.hops[i].sample_index);
+            failures++;
+            break;
+        }
+    }
+    if(slow.num_events != fast.num_events) {
+        fprintf(stderr, "FAIL: %d beat events at 30 fps, %d at 240 fps\n", slow.num_events, fast.num_events);
+        failures++;
+    }
+    FORI(0, MIN(slow.num_events, fast.num_events)) {
+        if(!same_event(slow.events + i, fast.events + i)) {
+            fprintf(stderr, "FAIL: beat event %d differs between 30 and 240 fps\n", i);
+            failures++;
+            break;
+        }
+    }
+
+    // Identical but empty results would prove nothing.
+    struct HopResult const* last = slow.hops + slow.num_hops - 1;
+    if(last->beats == 0 || slow.num_events == 0) {
+        fprintf(stderr, "FAIL: no beats detected in the test track\n");
+        failures++;
+    }
+
+    printf("beat_cadence: %d hops, %d beats, %d events, tempo %.1f bpm, %s\n", slow.num_hops, last->beats,
+           slow.num_events, (double)last->tempo.bpm, failures == 0 ? "identical at 30 and 240 fps" : "FAILED");
+
+    free(slow.hops);
+    free(fast.hops);
+    free(interleaved);
+    return failures == 0 ? 0 : 1;
+}
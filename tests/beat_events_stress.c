@@ -0,0 +1,150 @@
+// Races a producer thread pushing numbered beat events against the consumer
+// popping them. Popped events have to come out in order, whole, and together
+// with the ones the producer saw dropped on a full queue account for all of them.
+
+// Required for sched_yield.
+#define _DEFAULT_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "beat_events.h"
+#include "globals.h"
+
+#define CAPACITY 64
+#define NUM_EVENTS 2000000ull
+
+// The fields of event `n`, so a torn copy shows up as a mismatch. Exact in a float.
+__attribute__((const)) struct BeatEvent event_of_index(uint64_t n) {
+    return (struct BeatEvent){
+        .sample_index = n, .band = (int)(n % 7) - 1, .strength = (float)(n & 0xffff) + 0.5f};
+}
+
+// Without tripping -Wfloat-equal, the values are exact.
+__attribute__((const)) bool is_exactly(float value, float expected) { return !(value < expected || value > expected); }
+
+__attribute__((const)) bool same_event(struct BeatEvent a, struct BeatEvent b) {
+    return a.sample_index == b.sample_index && a.band == b.band && is_exactly(a.strength, b.strength);
+}
+
+__attribute__((const)) uint32_t next_random(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+struct Producer {
+    BeatEvents beat_events;
+    // Set once it's done.
+    uint64_t num_dropped;
+    atomic_bool done;
+};
+
+void* producer_function(void* data) {
+    struct Producer* producer = (struct Producer*)data;
+    uint32_t random = 123456789u;
+    uint64_t num_dropped = 0;
+    for(uint64_t n = 0; n < NUM_EVENTS; n++) {
+        // Pauses of random length with bursts in between, so that the queue
+        // runs full as well as empty.
+        random = next_random(random);
+        int pause = random % 8 == 0 ? (int)(random % 4096) : 0;
+        FORI(0, pause) {
+            atomic_signal_fence(memory_order_seq_cst);
+        }
+        // Lets the consumer in on a single core too.
+        if(random % 256 == 0) {
+            sched_yield();
+        }
+        num_dropped += push_beat_event(producer->beat_events, event_of_index(n)) ? 0 : 1;
+    }
+    producer->num_dropped = num_dropped;
+    atomic_store(&producer->done, true);
+    return NULL;
+}
+
+// Without a consumer a full queue keeps the oldest events.
+int check_full_queue(void) {
+    BeatEvents beat_events = create_beat_events(4, 0);
+    int num_pushed = 0;
+    FORI(0, 6) {
+        num_pushed += push_beat_event(beat_events, event_of_index((uint64_t)i)) ? 1 : 0;
+    }
+    int failures = num_pushed == 4 ? 0 : 1;
+    struct BeatEvent event;
+    FORI(0, 4) {
+        if(!pop_beat_event(beat_events, &event) || !same_event(event, event_of_index((uint64_t)i))) {
+            failures++;
+        }
+    }
+    failures += pop_beat_event(beat_events, &event) ? 1 : 0;
+    delete_beat_events(beat_events);
+    if(failures > 0) {
+        fprintf(stderr, "FAIL: a full queue of 4 took %d of 6 events or lost the oldest\n", num_pushed);
+    }
+    return failures;
+}
+
+int main(void) {
+    int failures = check_full_queue();
+
+    struct Producer producer = {.beat_events = create_beat_events(CAPACITY, 0)};
+    atomic_init(&producer.done, false);
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, producer_function, &producer) != 0) {
+        fprintf(stderr, "FAIL: pthread_create\n");
+        return 1;
+    }
+
+    uint32_t random = 987654321u;
+    uint64_t num_popped = 0;
+    uint64_t num_skipped = 0;
+    uint64_t next_index = 0;
+    bool finished = false;
+    while(!finished && failures == 0) {
+        // Pop what is left once more after the producer stopped.
+        finished = atomic_load(&producer.done);
+        random = next_random(random);
+        // Like an upload, takes all or only a few events at a time.
+        int max_pops = finished || random % 2 == 0 ? CAPACITY : 1 + (int)(random % 4);
+        struct BeatEvent event;
+        int i = 0;
+        for(; i < max_pops && pop_beat_event(producer.beat_events, &event); i++) {
+            num_popped++;
+            if(event.sample_index < next_index || !same_event(event, event_of_index(event.sample_index))) {
+                fprintf(stderr, "FAIL: popped event %llu (band %d, strength %g) after %llu\n",
+                        (unsigned long long)event.sample_index, event.band, (double)event.strength,
+                        (unsigned long long)next_index);
+                failures++;
+                break;
+            }
+            // Dropped ones leave gaps.
+            num_skipped += event.sample_index - next_index;
+            next_index = event.sample_index + 1;
+        }
+        if(i == 0) {
+            sched_yield();
+        }
+    }
+
+    pthread_join(thread, NULL);
+    num_skipped += NUM_EVENTS - next_index;
+    if(failures == 0 && (num_popped + producer.num_dropped != NUM_EVENTS || num_skipped != producer.num_dropped)) {
+        fprintf(stderr, "FAIL: %llu popped and %llu dropped of %llu events, %llu missing\n",
+                (unsigned long long)num_popped, (unsigned long long)producer.num_dropped,
+                (unsigned long long)NUM_EVENTS, (unsigned long long)num_skipped);
+        failures++;
+    }
+    delete_beat_events(producer.beat_events);
+
+    printf("beat_events_stress: %llu events, %llu popped, %llu dropped on a full queue, %s\n",
+           (unsigned long long)NUM_EVENTS, (unsigned long long)num_popped, (unsigned long long)producer.num_dropped,
+           failures == 0 ? "all in order and whole" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
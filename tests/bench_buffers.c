@@ -0,0 +1,161 @@
+// Upload throughput of the streaming buffers against plain glBufferSubData
+// ones. Every frame rewrites the buffer and dispatches a shader that reads it,
+// with at most two frames in flight like a swap interval would allow. The
+// shader adds up the frame numbers it saw, which has to match at the end.
+
+#define GL_GLEXT_PROTOTYPES
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SDL2/SDL_opengl.h>
+
+#include "buffers.h"
+#include "globals.h"
+#include "sdl.h"
+#include "size.h"
+#include "window.h"
+
+#define NUM_FRAMES 600
+#define FRAMES_IN_FLIGHT 2
+#define DATA_BINDING 0
+#define RESULT_BINDING 1
+
+static char const* const shader_source =
+    "#version 430\n"
+    "layout(local_size_x = 64) in;\n"
+    "layout(std430, binding = 0) readonly buffer data { uint values[]; };\n"
+    "layout(std430, binding = 1) buffer result { uint first_sum; uint last_sum; float busy; };\n"
+    "uniform int work;\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    float x = float(values[i % uint(values.length())]);\n"
+    "    for(int j = 0; j < work; j++) {\n"
+    "        x = sin(x) * 1.0001 + 0.5;\n"
+    "    }\n"
+    "    if(i == 0u) {\n"
+    "        first_sum += values[0];\n"
+    "        last_sum += values[values.length() - 1];\n"
+    "        busy = x;\n"
+    "    }\n"
+    "}\n";
+
+static int failures = 0;
+
+GLuint create_summing_program(void) {
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &shader_source, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if(status != GL_TRUE) {
+        char log[1024];
+        glGetShaderInfoLog(shader, isizeof(log), NULL, log);
+        fprintf(stderr, "Failed to compile the benchmark shader:\n%s\n", log);
+        exit(1);
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glDeleteShader(shader);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if(status != GL_TRUE) {
+        fprintf(stderr, "Failed to link the benchmark shader\n");
+        exit(1);
+    }
+    return program;
+}
+
+// Runs `NUM_FRAMES` frames rewriting `size` bytes of `buffer` each, with
+// `work` iterations per invocation keeping the GPU busy meanwhile.
+void time_uploads(char const* name, Buffer buffer, int size, int work, GLuint program) {
+    uint32_t result[3] = {0, 0, 0};
+    Buffer result_buffer = create_storage_buffer(isizeof(result), RESULT_BINDING);
+    copy_buffer_to_gpu(result_buffer, result, 0, isizeof(result));
+
+    int num_values = size / isizeof(uint32_t);
+    uint32_t* values = ALLOCATE(num_values, uint32_t);
+    memset(values, 0, (size_t)num_values * sizeof(uint32_t));
+    GLsync fences[FRAMES_IN_FLIGHT] = {NULL};
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "work"), work);
+
+    double upload_seconds = 0.0;
+    uint32_t expected = 0;
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_FRAMES) {
+        // Like a swap interval, don't run ahead of the GPU by more than a few frames.
+        GLsync* fence = fences + i % FRAMES_IN_FLIGHT;
+        if(*fence != NULL) {
+            glClientWaitSync(*fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            glDeleteSync(*fence);
+        }
+
+        uint32_t frame = (uint32_t)i + 1;
+        values[0] = frame;
+        values[num_values - 1] = frame;
+        expected += frame;
+        double upload_start = get_monotonic_seconds();
+        copy_buffer_to_gpu(buffer, values, 0, size);
+        commit_buffer_to_gpu(buffer);
+        upload_seconds += get_monotonic_seconds() - upload_start;
+
+        glDispatchCompute(64, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        *fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    glFinish();
+    double elapsed = get_monotonic_seconds() - start;
+
+    // Reads back the sums the shader kept.
+    GLuint result_name = 0;
+    glGetIntegeri_v(GL_SHADER_STORAGE_BUFFER_BINDING, RESULT_BINDING, (GLint*)&result_name);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, result_name);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, isizeof(result), result);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    bool ok = result[0] == expected && result[1] == expected;
+
+    printf("  %-9s %8d bytes, work %4d: %7.3f ms per frame, %7.3f ms uploading, %6.2f GB/s%s\n", name, size, work,
+           1e3 * elapsed / NUM_FRAMES, 1e3 * upload_seconds / NUM_FRAMES,
+           (double)size * NUM_FRAMES / upload_seconds / 1e9, ok ? "" : "  FAIL");
+    failures += ok ? 0 : 1;
+
+    FORI(0, FRAMES_IN_FLIGHT) {
+        if(fences[i] != NULL) {
+            glDeleteSync(fences[i]);
+        }
+    }
+    free(values);
+    delete_buffer(result_buffer);
+}
+
+int main(void) {
+    create_sdl();
+    Window window = create_window((struct Size){.w = 64, .h = 64});
+    GLuint program = create_summing_program();
+    printf("bench_buffers: %s, %s\n", (char const*)glGetString(GL_RENDERER), (char const*)glGetString(GL_VERSION));
+
+    // The analysis data and the whole PCM ring, with idle and with busy shaders.
+    int const sizes[] = {16 << 10, 1408 << 10};
+    int const works[] = {0, 256};
+    FORI(0, isizeof(sizes) / isizeof(sizes[0])) {
+        for(int j = 0; j < isizeof(works) / isizeof(works[0]); j++) {
+            Buffer buffer = create_storage_buffer(sizes[i], DATA_BINDING);
+            time_uploads("subdata", buffer, sizes[i], works[j], program);
+            delete_buffer(buffer);
+
+            buffer = create_streaming_storage_buffer(sizes[i], DATA_BINDING);
+            time_uploads("streaming", buffer, sizes[i], works[j], program);
+            delete_buffer(buffer);
+        }
+    }
+
+    glDeleteProgram(program);
+    delete_window(window);
+    delete_sdl();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Time per frame of the constant-Q transform and the filterbank next to the
+// plain DFT they are computed along with, and of the sparse product kernels.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cqt.h"
+#include "dft.h"
+#include "filterbank.h"
+#include "globals.h"
+#include "simd.h"
+
+#define SAMPLE_RATE 44100
+#define DFT_SIZE 4096
+#define NUM_BINS (DFT_SIZE / 2 + 1)
+#define HOP_SIZE 512
+#define NUM_BANDS 64
+#define NUM_RUNS 20000
+
+typedef void (*SparseFunction)(int, int const*, int const*, float const*, float const*, float*);
+
+// Triangles over the bins like a filterbank, each overlapping the next, wider with
+// frequency. They cover every bin about twice, 3 * NUM_BINS weights is plenty.
+int create_triangles(int** row_offsets, int** columns, float** values) {
+    *row_offsets = ALLOCATE(NUM_BANDS + 1, int);
+    *columns = ALLOCATE(3 * NUM_BINS, int);
+    *values = ALLOCATE(3 * NUM_BINS, float);
+    int num_values = 0;
+    FORI(0, NUM_BANDS) {
+        (*row_offsets)[i] = num_values;
+        int first = i * i * (NUM_BINS - 1) / (NUM_BANDS * NUM_BANDS);
+        int last = MIN((i + 2) * (i + 2) * (NUM_BINS - 1) / (NUM_BANDS * NUM_BANDS), NUM_BINS - 1);
+        for(int j = first; j <= last; j++) {
+            (*columns)[num_values] = j;
+            (*values)[num_values] = 1.0f - (float)abs(2 * j - first - last) / (float)MAX(last - first, 1);
+            num_values++;
+        }
+    }
+    (*row_offsets)[NUM_BANDS] = num_values;
+    return num_values;
+}
+
+void time_sparse(char const* name, SparseFunction function, int const* row_offsets, int const* columns,
+                 float const* values, float const* x) {
+    float y[NUM_BANDS];
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_RUNS) {
+        function(NUM_BANDS, row_offsets, columns, values, x, y);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    float sum = 0.0f;
+    FORI(0, NUM_BANDS) {
+        sum += y[i];
+    }
+    printf("  sparse product %-7s %7.3f us per frame (sum %g)\n", name, 1e6 * elapsed / NUM_RUNS, (double)sum);
+}
+
+int main(void) {
+    int* row_offsets;
+    int* columns;
+    float* values;
+    int num_values = create_triangles(&row_offsets, &columns, &values);
+    float* x = ALLOCATE(NUM_BINS, float);
+    uint32_t random = 1;
+    FORI(0, NUM_BINS) {
+        random = random * 1664525u + 1013904223u;
+        x[i] = (float)(random >> 8) / (float)(1 << 24);
+    }
+
+    printf("bench_cqt: %d bands over %d bins, %d weights\n", NUM_BANDS, NUM_BINS, num_values);
+    time_sparse("scalar", sparse_matrix_vector_scalar, row_offsets, columns, values, x);
+#if defined(__x86_64__)
+    if(has_avx2()) {
+        time_sparse("avx2", sparse_matrix_vector_avx2, row_offsets, columns, values, x);
+    }
+#endif
+
+    // Ten seconds of noise, one hop per call like the analysis thread.
+    int const num_samples = 10 * SAMPLE_RATE;
+    float* interleaved = ALLOCATE(2 * num_samples, float);
+    FORI(0, 2 * num_samples) {
+        random = random * 1664525u + 1013904223u;
+        interleaved[i] = (float)(random >> 8) / (float)(1 << 24) - 0.5f;
+    }
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = SAMPLE_RATE};
+    Pcm pcm = create_pcm(4 * SAMPLE_RATE, format, 0);
+    DftData dft_data = create_dft_data(DFT_SIZE, HOP_SIZE, SAMPLE_RATE, false, DFT_PLANNING_ESTIMATE, 0);
+    Cqt cqt = create_cqt(dft_data, 24, 30.0f, DFT_PLANNING_ESTIMATE, 0);
+    Filterbank filterbank = create_filterbank(dft_data, NUM_BANDS, FILTERBANK_MEL, 30.0f, 16000.0f, 0);
+
+    double dft_seconds = 0.0;
+    double cqt_seconds = 0.0;
+    double filterbank_seconds = 0.0;
+    int num_frames = 0;
+    for(int offset = 0; offset + HOP_SIZE <= num_samples; offset += HOP_SIZE) {
+        write_pcm_samples(pcm, interleaved + 2 * offset, HOP_SIZE);
+        double start = get_monotonic_seconds();
+        compute_dft_frames(pcm, dft_data);
+        dft_seconds += get_monotonic_seconds() - start;
+        while(next_dft_frame(dft_data)) {
+            start = get_monotonic_seconds();
+            compute_cqt(pcm, dft_data, cqt);
+            double cqt_end = get_monotonic_seconds();
+            compute_filterbank(dft_data, filterbank);
+            filterbank_seconds += get_monotonic_seconds() - cqt_end;
+            cqt_seconds += cqt_end - start;
+            num_frames++;
+        }
+    }
+    int n = MAX(num_frames, 1);
+    printf("  %d frames, per frame:\n", num_frames);
+    printf("  dft        %d points %8.2f us\n", DFT_SIZE, 1e6 * dft_seconds / n);
+    printf("  cqt        %d bins   %8.2f us\n", num_bins_of_cqt(cqt), 1e6 * cqt_seconds / n);
+    printf("  filterbank %d bands  %8.2f us\n", NUM_BANDS, 1e6 * filterbank_seconds / n);
+
+    delete_filterbank(filterbank);
+    delete_cqt(cqt);
+    delete_dft_data(dft_data);
+    delete_pcm(pcm);
+    free(interleaved);
+    free(x);
+    free(values);
+    free(columns);
+    free(row_offsets);
+    return 0;
+}
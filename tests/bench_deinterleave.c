@@ -0,0 +1,80 @@
+// Throughput of the stereo deinterleave kernels in GB/s, counting the bytes
+// read and written, for a cache resident block and one that isn't.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "simd.h"
+
+#define MAX_SAMPLES (1 << 22)
+// Bytes moved per run, about the same for every block size.
+#define BYTES_PER_SIZE (1ll << 32)
+
+typedef void (*DeinterleaveFunction)(float const*, float*, float*, int);
+
+// The loop as it was before the kernels, kept from being vectorized by -O3.
+__attribute__((optimize("no-tree-vectorize"))) void deinterleave_plain(float const* interleaved, float* left,
+                                                                     float* right, int num_samples) {
+    for(int i = 0; i < num_samples; i++) {
+        left[i] = interleaved[2 * i];
+        right[i] = interleaved[2 * i + 1];
+    }
+}
+
+static int failures = 0;
+
+void time_deinterleave(char const* name, DeinterleaveFunction function, float const* interleaved, float* left,
+                       float* right, int num_samples) {
+    // Check it first, garbage can be fast.
+    memset(left, 0, (size_t)num_samples * sizeof(float));
+    memset(right, 0, (size_t)num_samples * sizeof(float));
+    function(interleaved, left, right, num_samples);
+    FORI(0, num_samples) {
+        if(memcmp(left + i, interleaved + 2 * i, sizeof(float)) != 0 ||
+           memcmp(right + i, interleaved + 2 * i + 1, sizeof(float)) != 0) {
+            printf("  %-7s %8d samples  FAIL at sample %d\n", name, num_samples, i);
+            failures++;
+            return;
+        }
+    }
+
+    long long bytes_per_run = 4ll * isizeof(float) * num_samples;
+    long long num_runs = MAX(BYTES_PER_SIZE / bytes_per_run, 1);
+    double start = get_monotonic_seconds();
+    for(long long run = 0; run < num_runs; run++) {
+        function(interleaved, left, right, num_samples);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    printf("  %-7s %8d samples %7.2f GB/s\n", name, num_samples, (double)(bytes_per_run * num_runs) / elapsed / 1e9);
+}
+
+int main(void) {
+    float* interleaved = ALLOCATE(2 * MAX_SAMPLES, float);
+    float* left = ALLOCATE(MAX_SAMPLES, float);
+    float* right = ALLOCATE(MAX_SAMPLES, float);
+    FORI(0, 2 * MAX_SAMPLES) {
+        interleaved[i] = (float)i;
+    }
+
+    printf("bench_deinterleave:\n");
+    // A block as the ingest thread reads it, an odd one for the tails and one
+    // larger than the caches.
+    int const sizes[] = {4096, 4099, MAX_SAMPLES};
+    FORI(0, isizeof(sizes) / isizeof(sizes[0])) {
+        time_deinterleave("plain", deinterleave_plain, interleaved, left, right, sizes[i]);
+        time_deinterleave("scalar", deinterleave_stereo_scalar, interleaved, left, right, sizes[i]);
+#if defined(__x86_64__)
+        time_deinterleave("sse2", deinterleave_stereo_sse2, interleaved, left, right, sizes[i]);
+        if(has_avx2()) {
+            time_deinterleave("avx2", deinterleave_stereo_avx2, interleaved, left, right, sizes[i]);
+        }
+#endif
+    }
+
+    free(right);
+    free(left);
+    free(interleaved);
+    return failures == 0 ? 0 : 1;
+}
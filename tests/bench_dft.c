@@ -0,0 +1,148 @@
+// Time per frame of the steps of the short-time transform: the window, the
+// magnitudes against the per-bin formula they replaced, and the whole
+// compute_dft_frames with one and with several hops per call.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dft.h"
+#include "globals.h"
+#include "simd.h"
+
+#define SAMPLE_RATE 44100
+#define DFT_SIZE 4096
+#define NUM_BINS (DFT_SIZE / 2 + 1)
+#define HOP_SIZE 512
+#define NUM_RUNS 20000
+
+typedef void (*WindowFunction)(float const*, float const*, float const*, float*, int);
+typedef void (*MagnitudesFunction)(float const*, int, float*, int, int);
+
+static int failures = 0;
+
+// The mono window as it was before the kernels, kept from being vectorized by -O3.
+__attribute__((optimize("no-tree-vectorize"))) void mix_window_plain(float const* left, float const* right,
+                                                                   float const* window, float* dst,
+                                                                   int num_values) {
+    for(int i = 0; i < num_values; i++) {
+        dst[i] = 0.5f * (left[i] + right[i]) * window[i];
+    }
+}
+
+// What dft_at() computed per bin before the magnitudes were kept per frame.
+void magnitudes_plain(float const* halfcomplex, int size, float* magnitudes, int first, int last) {
+    for(int k = first; k < last; k++) {
+        magnitudes[k] = sqrtf(powf(halfcomplex[k], 2.0) + powf(halfcomplex[size - k], 2));
+    }
+}
+
+void time_window(char const* name, WindowFunction function, float const* left, float const* right,
+                 float const* window, float* dst) {
+    static float expected[DFT_SIZE];
+    mix_window_scalar(left, right, window, expected, DFT_SIZE);
+    function(left, right, window, dst, DFT_SIZE);
+    bool ok = memcmp(dst, expected, sizeof(expected)) == 0;
+
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_RUNS) {
+        function(left, right, window, dst, DFT_SIZE);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    printf("  window     %-7s %7.3f us per frame%s\n", name, 1e6 * elapsed / NUM_RUNS, ok ? "" : "  FAIL");
+    failures += ok ? 0 : 1;
+}
+
+void time_magnitudes(char const* name, MagnitudesFunction function, float const* halfcomplex, float* magnitudes) {
+    static float expected[NUM_BINS];
+    halfcomplex_magnitudes_scalar(halfcomplex, DFT_SIZE, expected, 1, DFT_SIZE / 2);
+    function(halfcomplex, DFT_SIZE, magnitudes, 1, DFT_SIZE / 2);
+    bool ok = true;
+    FORI(1, DFT_SIZE / 2) {
+        ok = ok && fabsf(magnitudes[i] - expected[i]) <= 1e-6f * expected[i];
+    }
+
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_RUNS) {
+        function(halfcomplex, DFT_SIZE, magnitudes, 1, DFT_SIZE / 2);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    printf("  magnitude  %-7s %7.3f us per frame%s\n", name, 1e6 * elapsed / NUM_RUNS, ok ? "" : "  FAIL");
+    failures += ok ? 0 : 1;
+}
+
+// Feeds `hops_per_call` hops between the calls, 1 never fills a batch.
+void time_compute_dft_frames(bool stereo, int hops_per_call, float const* interleaved, int num_samples) {
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = SAMPLE_RATE};
+    Pcm pcm = create_pcm(4 * SAMPLE_RATE, format, 0);
+    DftData dft_data = create_dft_data(DFT_SIZE, HOP_SIZE, SAMPLE_RATE, stereo, DFT_PLANNING_ESTIMATE, 0);
+    // Fill the first window outside the timing.
+    write_pcm_samples(pcm, interleaved, DFT_SIZE);
+    compute_dft_frames(pcm, dft_data);
+
+    int chunk = hops_per_call * HOP_SIZE;
+    int num_frames = 0;
+    double start = get_monotonic_seconds();
+    for(int offset = DFT_SIZE; offset + chunk <= num_samples; offset += chunk) {
+        write_pcm_samples(pcm, interleaved + 2 * offset, chunk);
+        num_frames += compute_dft_frames(pcm, dft_data);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    printf("  compute_dft_frames %-6s %d hops per call %8.2f us per frame\n", stereo ? "stereo" : "mono", hops_per_call,
+           1e6 * elapsed / MAX(num_frames, 1));
+
+    delete_dft_data(dft_data);
+    delete_pcm(pcm);
+}
+
+int main(void) {
+    static float left[DFT_SIZE];
+    static float right[DFT_SIZE];
+    static float window[DFT_SIZE];
+    static float dst[DFT_SIZE];
+    static float magnitudes[NUM_BINS];
+    uint32_t x = 1;
+    FORI(0, DFT_SIZE) {
+        x = x * 1664525u + 1013904223u;
+        left[i] = (float)(x >> 8) / (float)(1 << 24) - 0.5f;
+        right[i] = -left[i];
+        window[i] = 0.54f - 0.46f * cosf(2.0f * PI * (float)i / (float)(DFT_SIZE - 1));
+    }
+
+    printf("bench_dft: %d point frames, %d runs\n", DFT_SIZE, NUM_RUNS);
+    time_window("plain", mix_window_plain, left, right, window, dst);
+    time_window("scalar", mix_window_scalar, left, right, window, dst);
+#if defined(__x86_64__)
+    time_window("sse2", mix_window_sse2, left, right, window, dst);
+    if(has_avx2()) {
+        time_window("avx2", mix_window_avx2, left, right, window, dst);
+    }
+#endif
+
+    // `left` makes a fine halfcomplex spectrum.
+    time_magnitudes("plain", magnitudes_plain, left, magnitudes);
+    time_magnitudes("scalar", halfcomplex_magnitudes_scalar, left, magnitudes);
+#if defined(__x86_64__)
+    time_magnitudes("sse2", halfcomplex_magnitudes_sse2, left, magnitudes);
+    if(has_avx2()) {
+        time_magnitudes("avx2", halfcomplex_magnitudes_avx2, left, magnitudes);
+    }
+#endif
+
+    // Ten seconds of noise, the FFT dominates these.
+    int const num_samples = 10 * SAMPLE_RATE;
+    float* interleaved = ALLOCATE(2 * num_samples, float);
+    FORI(0, 2 * num_samples) {
+        x = x * 1664525u + 1013904223u;
+        interleaved[i] = (float)(x >> 8) / (float)(1 << 24) - 0.5f;
+    }
+    time_compute_dft_frames(false, 1, interleaved, num_samples);
+    time_compute_dft_frames(false, 8, interleaved, num_samples);
+    time_compute_dft_frames(true, 1, interleaved, num_samples);
+    time_compute_dft_frames(true, 8, interleaved, num_samples);
+
+    free(interleaved);
+    return failures == 0 ? 0 : 1;
+}
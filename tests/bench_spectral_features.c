@@ -0,0 +1,60 @@
+// Time per frame of the spectral features over a 4096 point DFT, and of the
+// kernel variants behind them.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "globals.h"
+#include "simd.h"
+#include "spectral_features.h"
+
+#define NUM_BINS 2049
+#define NUM_RUNS 20000
+
+typedef void (*SumsFunction)(float const*, float const*, int, int, struct SpectrumSums*);
+
+void time_sums(char const* name, SumsFunction function, float const* magnitudes, float const* previous) {
+    struct SpectrumSums sums = {0};
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_RUNS) {
+        sums = (struct SpectrumSums){0};
+        function(magnitudes, previous, 0, NUM_BINS, &sums);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    // Printing the result keeps the calls from being optimized away.
+    printf("  spectrum_sums %-8s %7.2f us per frame (sum %g)\n", name, 1e6 * elapsed / NUM_RUNS, (double)sums.sum);
+}
+
+int main(void) {
+    float* magnitudes = ALLOCATE(NUM_BINS, float);
+    float* previous = ALLOCATE(NUM_BINS, float);
+    uint32_t x = 1;
+    FORI(0, NUM_BINS) {
+        x = x * 1664525u + 1013904223u;
+        magnitudes[i] = (float)(x >> 8) / (float)(1 << 24);
+        previous[i] = magnitudes[(i * 7) % NUM_BINS];
+    }
+
+    printf("bench_spectral_features: %d bins, %d runs\n", NUM_BINS, NUM_RUNS);
+    time_sums("scalar", spectrum_sums_scalar, magnitudes, previous);
+#if defined(__x86_64__)
+    time_sums("sse2", spectrum_sums_sse2, magnitudes, previous);
+    if(has_avx2()) {
+        time_sums("avx2", spectrum_sums_avx2, magnitudes, previous);
+    }
+#endif
+
+    struct SpectralFeatures features = {0};
+    double start = get_monotonic_seconds();
+    FORI(0, NUM_RUNS) {
+        compute_spectral_features(magnitudes, previous, NUM_BINS, 10.77f, &features);
+    }
+    double elapsed = get_monotonic_seconds() - start;
+    printf("  compute_spectral_features %7.2f us per frame (centroid %g)\n", 1e6 * elapsed / NUM_RUNS,
+           (double)features.centroid);
+
+    free(previous);
+    free(magnitudes);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// The interleaved patterns over odd and even image sizes. Each frame every
+// pixel has to be either rendered or filled in, each filled in one only from
+// pixels rendered that frame, and over `factor` frames every pixel has to be
+// rendered once. The pixel mappings are those of `interleaved_pixel` in
+// ray_march.comp and of reconstruct.comp, with the phases the module uploads.
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "globals.h"
+#include "interleave.h"
+
+static int failures = 0;
+
+struct Pixel {
+    int x;
+    int y;
+};
+
+__attribute__((const)) bool in_image(struct Pixel p, struct Size size) {
+    return p.x >= 0 && p.y >= 0 && p.x < size.w && p.y < size.h;
+}
+
+// `interleaved_pixel` in ray_march.comp.
+__attribute__((const)) struct Pixel interleaved_pixel(int factor, int phase, int x, int y) {
+    switch(factor) {
+    case 2:
+        return (struct Pixel){2 * x + ((y + phase) & 1), y};
+    case 4:
+        return (struct Pixel){2 * x + (phase & 1), 2 * y + (phase >> 1)};
+    default:
+        return (struct Pixel){x, y};
+    }
+}
+
+struct Frame {
+    struct Size size;
+    // Per pixel, how often it was rendered and filled in.
+    int* rendered;
+    int* filled;
+};
+
+// `fill_in` in reconstruct.comp, records the pixel and checks its neighbours.
+void fill_in(struct Frame* frame, struct Pixel pixel, struct Pixel const offsets[4]) {
+    if(!in_image(pixel, frame->size)) {
+        return;
+    }
+    frame->filled[pixel.y * frame->size.w + pixel.x]++;
+    FORI(0, 4) {
+        struct Pixel neighbour = {pixel.x + offsets[i].x, pixel.y + offsets[i].y};
+        if(neighbour.x < 0 || neighbour.x >= frame->size.w) {
+            neighbour.x = pixel.x - offsets[i].x;
+        }
+        if(neighbour.y < 0 || neighbour.y >= frame->size.h) {
+            neighbour.y = pixel.y - offsets[i].y;
+        }
+        bool fresh = in_image(neighbour, frame->size) && frame->rendered[neighbour.y * frame->size.w + neighbour.x] > 0;
+        if(!fresh) {
+            fprintf(stderr, "FAIL: %dx%d, pixel %d,%d filled in from %d,%d which wasn't rendered\n", frame->size.w,
+                    frame->size.h, pixel.x, pixel.y, neighbour.x, neighbour.y);
+            failures++;
+        }
+    }
+}
+
+// The invocation at `x`, `y` of reconstruct.comp.
+void reconstruct(struct Frame* frame, int factor, int phase, int x, int y) {
+    if(factor == 2) {
+        struct Pixel pixel = {2 * x + ((y + phase + 1) & 1), y};
+        struct Pixel const offsets[4] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+        fill_in(frame, pixel, offsets);
+    } else if(factor == 4) {
+        struct Pixel fresh = {phase & 1, phase >> 1};
+        FORI(0, 4) {
+            struct Pixel corner = {i & 1, i >> 1};
+            if(corner.x == fresh.x && corner.y == fresh.y) {
+                continue;
+            }
+            struct Pixel across = {abs(fresh.x - corner.x), abs(fresh.y - corner.y)};
+            struct Pixel const offsets[4] = {
+                across, {-across.x, across.y}, {across.x, -across.y}, {-across.x, -across.y}};
+            fill_in(frame, (struct Pixel){2 * x + corner.x, 2 * y + corner.y}, offsets);
+        }
+    }
+}
+
+void check_pattern(int factor, struct Size size) {
+    Interleave interleave = create_interleave(factor, 0);
+    struct Size dispatch = dispatch_size_of_interleave(interleave, size);
+    int num_pixels = size.w * size.h;
+    int* rendered_total = ALLOCATE(num_pixels, int);
+    memset(rendered_total, 0, (size_t)num_pixels * sizeof(int));
+    struct Frame frame = {.size = size, .rendered = ALLOCATE(num_pixels, int), .filled = ALLOCATE(num_pixels, int)};
+    int failures_before = failures;
+
+    FORI(0, factor) {
+        advance_interleave(interleave);
+        int phase = phase_of_interleave(interleave);
+        memset(frame.rendered, 0, (size_t)num_pixels * sizeof(int));
+        memset(frame.filled, 0, (size_t)num_pixels * sizeof(int));
+        for(int y = 0; y < dispatch.h; y++) {
+            for(int x = 0; x < dispatch.w; x++) {
+                // The shaders skip invocations outside the image.
+                struct Pixel pixel = interleaved_pixel(factor, phase, x, y);
+                if(in_image(pixel, size)) {
+                    frame.rendered[pixel.y * size.w + pixel.x]++;
+                }
+            }
+        }
+        for(int y = 0; y < dispatch.h; y++) {
+            for(int x = 0; x < dispatch.w; x++) {
+                reconstruct(&frame, factor, phase, x, y);
+            }
+        }
+
+        for(int p = 0; p < num_pixels; p++) {
+            rendered_total[p] += frame.rendered[p];
+            if(frame.rendered[p] + frame.filled[p] != 1) {
+                fprintf(stderr, "FAIL: %dx%d, phase %d, pixel %d,%d rendered %d and filled in %d times\n", size.w,
+                        size.h, phase, p % size.w, p / size.w, frame.rendered[p], frame.filled[p]);
+                failures++;
+                break;
+            }
+        }
+    }
+    for(int p = 0; p < num_pixels; p++) {
+        if(rendered_total[p] != 1) {
+            fprintf(stderr, "FAIL: %dx%d, pixel %d,%d rendered %d times in %d frames\n", size.w, size.h, p % size.w,
+                    p / size.w, rendered_total[p], factor);
+            failures++;
+            break;
+        }
+    }
+
+    printf("  factor %d, %4dx%-4d %s\n", factor, size.w, size.h, failures == failures_before ? "covered" : "FAIL");
+    free(frame.filled);
+    free(frame.rendered);
+    free(rendered_total);
+    delete_interleave(interleave);
+}
+
+int main(void) {
+    printf("interleave_pattern:\n");
+    struct Size const sizes[] = {{2, 2}, {3, 3}, {64, 36}, {101, 37}};
+    int const factors[] = {2, 4};
+    FORI(0, isizeof(factors) / isizeof(factors[0])) {
+        for(int j = 0; j < isizeof(sizes) / isizeof(sizes[0]); j++) {
+            check_pattern(factors[i], sizes[j]);
+        }
+    }
+    printf("interleave_pattern: %s\n", failures == 0 ? "every pixel rendered once per cycle" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
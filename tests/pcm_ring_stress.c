@@ -0,0 +1,154 @@
+// Hammers the PCM ring with a producer thread writing a known sequence while
+// the consumer copies windows out of it. Every window reported consistent
+// has to hold exactly the samples of its range, the others have to show up
+// as torn reads or xruns in the stats.
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "globals.h"
+#include "pcm.h"
+
+// One page of floats, the ring doesn't round it up.
+#define RING_SAMPLES 1024
+#define NUM_SAMPLES 100000000ull
+
+// Sample `n` of the sequence, never 0 so that silence stands out. Exact in a float.
+__attribute__((const)) float left_of_sample(uint64_t n) { return (float)(n & 0xfffff) + 1.0f; }
+__attribute__((const)) float right_of_sample(uint64_t n) { return -left_of_sample(n); }
+
+// Without tripping -Wfloat-equal, the values are exact.
+__attribute__((const)) bool is_exactly(float value, float expected) { return !(value < expected || value > expected); }
+
+__attribute__((const)) uint32_t next_random(uint32_t x) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+struct Producer {
+    Pcm pcm;
+    // Set once it's done, it overshoots NUM_SAMPLES a little.
+    uint64_t num_written;
+    atomic_bool done;
+};
+
+void* producer_function(void* data) {
+    struct Producer* producer = (struct Producer*)data;
+    // Some chunks are larger than the ring, the producer then skips ahead.
+    int const max_chunk = 3 * RING_SAMPLES;
+    float* interleaved = ALLOCATE(2 * max_chunk, float);
+    uint32_t random = 123456789u;
+
+    uint64_t written = 0;
+    while(written < NUM_SAMPLES) {
+        random = next_random(random);
+        int num_samples = 1 + (int)(random % (uint32_t)max_chunk);
+        FORI(0, num_samples) {
+            interleaved[2 * i] = left_of_sample(written + (uint64_t)i);
+            interleaved[2 * i + 1] = right_of_sample(written + (uint64_t)i);
+        }
+        write_pcm_samples(producer->pcm, interleaved, num_samples);
+        written += (uint64_t)num_samples;
+    }
+
+    free(interleaved);
+    producer->num_written = written;
+    atomic_store(&producer->done, true);
+    return NULL;
+}
+
+int main(void) {
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 2, .sample_rate = 44100};
+    struct Producer producer = {.pcm = create_pcm(RING_SAMPLES, format, 0)};
+    atomic_init(&producer.done, false);
+    Pcm pcm = producer.pcm;
+
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, producer_function, &producer) != 0) {
+        fprintf(stderr, "FAIL: pthread_create\n");
+        return 1;
+    }
+
+    float left[RING_SAMPLES];
+    float right[RING_SAMPLES];
+    uint32_t random = 987654321u;
+    uint64_t num_windows = 0;
+    uint64_t num_consistent = 0;
+    uint64_t num_torn = 0;
+    uint64_t previous_end = 0;
+    int failures = 0;
+
+    bool finished = false;
+    while(!finished && failures == 0) {
+        // Read the final window once more after the producer stopped.
+        finished = atomic_load(&producer.done);
+        random = next_random(random);
+        if(random % 4 == 0) {
+            wait_for_pcm_samples(pcm, 1 + (int)(random % RING_SAMPLES), 1);
+        }
+
+        uint64_t xruns = get_pcm_stats(pcm).xruns;
+        struct PcmWindow window = consume_pcm(pcm);
+        num_windows++;
+
+        // Consumed windows follow each other, unless the reader fell behind,
+        // which has to be counted.
+        if(window.start != previous_end) {
+            if(get_pcm_stats(pcm).xruns != xruns + 1 || window.end - window.start != RING_SAMPLES) {
+                fprintf(stderr, "FAIL: window [%llu, %llu) after %llu without an xrun\n",
+                        (unsigned long long)window.start, (unsigned long long)window.end,
+                        (unsigned long long)previous_end);
+                failures++;
+            }
+        }
+        previous_end = window.end;
+
+        int num_samples = 1 + (int)(next_random(random) % RING_SAMPLES);
+        uint64_t torn_reads = get_pcm_stats(pcm).torn_reads;
+        if(!copy_pcm_window(pcm, window.end, num_samples, left, right)) {
+            num_torn++;
+            if(get_pcm_stats(pcm).torn_reads != torn_reads + 1) {
+                fprintf(stderr, "FAIL: torn copy not counted\n");
+                failures++;
+            }
+            continue;
+        }
+
+        num_consistent++;
+        FORI(0, num_samples) {
+            // Index of `left[i]`, before the start of the stream it's silence.
+            int64_t n = (int64_t)window.end - num_samples + i;
+            float expected_left = n < 0 ? 0.0f : left_of_sample((uint64_t)n);
+            float expected_right = n < 0 ? 0.0f : right_of_sample((uint64_t)n);
+            if(!is_exactly(left[i], expected_left) || !is_exactly(right[i], expected_right)) {
+                fprintf(stderr, "FAIL: consistent window ending at %llu has %g/%g at sample %lld, expected %g/%g\n",
+                        (unsigned long long)window.end, (double)left[i], (double)right[i], (long long)n,
+                        (double)expected_left, (double)expected_right);
+                failures++;
+                break;
+            }
+        }
+    }
+
+    pthread_join(thread, NULL);
+    if(failures == 0 && previous_end != producer.num_written) {
+        fprintf(stderr, "FAIL: consumed up to %llu of %llu samples\n", (unsigned long long)previous_end,
+                (unsigned long long)producer.num_written);
+        failures++;
+    }
+
+    struct PcmStats stats = get_pcm_stats(pcm);
+    printf("pcm_ring_stress: %llu windows, %llu consistent, %llu torn, %llu xruns, %llu dropped samples, %s\n",
+           (unsigned long long)num_windows, (unsigned long long)num_consistent, (unsigned long long)num_torn,
+           (unsigned long long)stats.xruns, (unsigned long long)stats.dropped_samples,
+           failures == 0 ? "all consistent windows exact" : "FAILED");
+
+    delete_pcm(pcm);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+// Feeds synthesized audio to the worker pipeline at a few times real time and
+// picks up its results like the render loop does. The per-stage timings that
+// come with them have to be reported, and they are cumulative so they can
+// only ever grow.
+
+// Required for nanosleep.
+#define _DEFAULT_SOURCE
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "analysis.h"
+#include "globals.h"
+#include "pipeline.h"
+
+#define SAMPLE_RATE 44100
+#define SECONDS 4
+#define HOP_SIZE 512
+// What a 60 fps render loop gets per frame, written every millisecond.
+#define SAMPLES_PER_WRITE (SAMPLE_RATE / 60)
+
+static int failures = 0;
+
+void fail(char const* message, int write_index) {
+    fprintf(stderr, "FAIL: %s after write %d\n", message, write_index);
+    failures++;
+}
+
+// Every stage has run at least once and taken some time.
+__attribute__((pure)) bool timings_reported(struct PipelineTimings const* timings) {
+    return timings->hops > 0 && timings->publishes > 0 && timings->dft_s > 0.0 && timings->analysis_s > 0.0;
+}
+
+void check_monotonic(struct PipelineTimings const* last, struct PipelineTimings const* timings, int write_index) {
+    if(timings->hops < last->hops || timings->publishes < last->publishes || timings->dft_s < last->dft_s ||
+       timings->analysis_s < last->analysis_s || timings->publish_s < last->publish_s) {
+        fail("timings went backwards", write_index);
+    }
+    // Every publish is of at least one new hop.
+    if(timings->publishes - last->publishes > timings->hops - last->hops) {
+        fail("more publishes than hops", write_index);
+    }
+}
+
+int main(void) {
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 1, .sample_rate = SAMPLE_RATE};
+    Pcm pcm = create_pcm(4 * SAMPLE_RATE, format, 0);
+    DftData dft_data = create_dft_data(4096, HOP_SIZE, SAMPLE_RATE, false, DFT_PLANNING_ESTIMATE, 0);
+    Spectrogram spectrogram = create_spectrogram(dft_data, 512, 0, 0);
+    Cqt cqt = create_cqt(dft_data, 24, 30.0f, DFT_PLANNING_ESTIMATE, 0);
+    Filterbank filterbank = create_filterbank(dft_data, 64, FILTERBANK_MEL, 30.0f, 16000.0f, 0);
+    BeatEvents beat_events = create_beat_events(64, 0);
+    struct BandLayout band_layout = default_band_layout();
+    Analysis analysis = create_analysis(dft_data, cqt, filterbank, beat_events, &band_layout, 0);
+    Pipeline pipeline = create_pipeline(pcm, dft_data, cqt, filterbank, analysis, spectrogram, HOP_SIZE, false);
+
+    int const num_samples = SECONDS * SAMPLE_RATE;
+    int const num_writes = num_samples / SAMPLES_PER_WRITE;
+    float samples[SAMPLES_PER_WRITE];
+    struct PipelineTimings last = timings_of_pipeline(pipeline);
+    if(timings_reported(&last)) {
+        fail("timings before any audio", 0);
+    }
+
+    uint32_t noise = 1;
+    FORI(0, num_writes) {
+        // A 440 Hz tone over some noise.
+        for(int j = 0; j < SAMPLES_PER_WRITE; j++) {
+            noise ^= noise << 13;
+            noise ^= noise >> 17;
+            noise ^= noise << 5;
+            float t = (float)(i * SAMPLES_PER_WRITE + j) / (float)SAMPLE_RATE;
+            samples[j] = 0.5f * sinf(2.0f * PI * 440.0f * t) + 0.1f * ((float)noise / (float)UINT32_MAX - 0.5f);
+        }
+        write_pcm_samples(pcm, samples, SAMPLES_PER_WRITE);
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 1000000}, NULL);
+
+        copy_pipeline_to_gpu(pipeline);
+        struct PipelineTimings timings = timings_of_pipeline(pipeline);
+        check_monotonic(&last, &timings, i);
+        last = timings;
+    }
+
+    // Gives the worker a moment to catch up with the last writes.
+    FORI(0, 100) {
+        nanosleep(&(struct timespec){.tv_sec = 0, .tv_nsec = 10000000}, NULL);
+        copy_pipeline_to_gpu(pipeline);
+        struct PipelineTimings timings = timings_of_pipeline(pipeline);
+        check_monotonic(&last, &timings, num_writes);
+        last = timings;
+    }
+
+    if(!timings_reported(&last)) {
+        fail("no hops or no stage timings reported", num_writes);
+    }
+    if(last.hops > (uint64_t)(num_samples / HOP_SIZE)) {
+        fail("more hops than the audio has", num_writes);
+    }
+
+    delete_pipeline(pipeline);
+    delete_analysis(analysis);
+    delete_beat_events(beat_events);
+    delete_filterbank(filterbank);
+    delete_cqt(cqt);
+    delete_spectrogram(spectrogram);
+    delete_dft_data(dft_data);
+    delete_pcm(pcm);
+
+    double hops = (double)MAX(last.hops, 1);
+    printf("pipeline_timings: %llu hops in %llu publishes, dft %.3f ms and analysis %.3f ms per hop, %s\n",
+           (unsigned long long)last.hops, (unsigned long long)last.publishes, 1000.0 * last.dft_s / hops,
+           1000.0 * last.analysis_s / hops, failures == 0 ? "reported and monotonic" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,207 @@
+// Golden values of the spectral features for white noise, a sine, silence and a
+// recording, computed from the DFT like the analysis does. Noise is checked
+// against the theory, the others against values taken from this implementation.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "dft.h"
+#include "globals.h"
+#include "pcm_file.h"
+#include "simd.h"
+#include "spectral_features.h"
+
+#define SAMPLE_RATE 44100
+#define DFT_SIZE 4096
+#define NUM_BINS (DFT_SIZE / 2 + 1)
+
+static int failures = 0;
+
+void check(char const* signal, char const* feature, float value, float expected, float tolerance) {
+    bool ok = fabsf(value - expected) <= tolerance;
+    printf("  %-7s %-9s %10.3f, expected %10.3f +- %g%s\n", signal, feature, (double)value, (double)expected,
+           (double)tolerance, ok ? "" : "  FAIL");
+    failures += ok ? 0 : 1;
+}
+
+// Features averaged over the DFT frames of the mono samples written to `pcm`.
+struct SpectralFeatures average_features_of_pcm(Pcm pcm) {
+    DftData dft_data = create_dft_data(DFT_SIZE, 512, SAMPLE_RATE, false, DFT_PLANNING_ESTIMATE, 0);
+    compute_dft_frames(pcm, dft_data);
+
+    struct SpectralFeatures sum = {0};
+    int num_frames = 0;
+    while(next_dft_frame(dft_data)) {
+        struct SpectralFeatures features;
+        float const* magnitudes = magnitudes_of_dft(dft_data);
+        compute_spectral_features(magnitudes, magnitudes, NUM_BINS, (float)SAMPLE_RATE / DFT_SIZE, &features);
+        sum.flux += features.flux;
+        sum.centroid += features.centroid;
+        sum.spread += features.spread;
+        sum.rolloff += features.rolloff;
+        sum.flatness += features.flatness;
+        sum.crest += features.crest;
+        num_frames++;
+    }
+
+    delete_dft_data(dft_data);
+    float n = (float)MAX(num_frames, 1);
+    return (struct SpectralFeatures){
+        .flux = sum.flux / n,
+        .centroid = sum.centroid / n,
+        .spread = sum.spread / n,
+        .rolloff = sum.rolloff / n,
+        .flatness = sum.flatness / n,
+        .crest = sum.crest / n,
+    };
+}
+
+// Features averaged over the DFT frames of one second of mono `samples`.
+struct SpectralFeatures average_features(float const* samples) {
+    struct PcmFormat format = {.sample_format = SAMPLE_FORMAT_F32LE, .channels = 1, .sample_rate = SAMPLE_RATE};
+    Pcm pcm = create_pcm(4 * SAMPLE_RATE, format, 0);
+    write_pcm_samples(pcm, samples, SAMPLE_RATE);
+    struct SpectralFeatures features = average_features_of_pcm(pcm);
+    delete_pcm(pcm);
+    return features;
+}
+
+void check_white_noise(float* samples) {
+    uint32_t x = 1;
+    FORI(0, SAMPLE_RATE) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        samples[i] = (float)x / (float)UINT32_MAX * 2.0f - 1.0f;
+    }
+    struct SpectralFeatures features = average_features(samples);
+
+    // A flat spectrum: the centroid sits at half the Nyquist frequency, the
+    // spread is that of a uniform distribution, the rolloff at 85% of Nyquist.
+    float nyquist = (float)SAMPLE_RATE / 2.0f;
+    check("noise", "centroid", features.centroid, nyquist / 2.0f, 0.02f * nyquist / 2.0f);
+    check("noise", "spread", features.spread, nyquist / sqrtf(12.0f), 0.02f * nyquist / sqrtf(12.0f));
+    check("noise", "rolloff", features.rolloff, 0.85f * nyquist, 0.02f * 0.85f * nyquist);
+    // Rayleigh distributed magnitudes, e^(-gamma / 2) / sqrt(pi / 4) = 0.845.
+    check("noise", "flatness", features.flatness, 0.845f, 0.02f);
+}
+
+void check_sine(float* samples) {
+    FORI(0, SAMPLE_RATE) {
+        samples[i] = 0.5f * sinf(2.0f * PI * 1000.0f * (float)i / (float)SAMPLE_RATE);
+    }
+    struct SpectralFeatures features = average_features(samples);
+
+    // The window's sidelobes pull the centroid up and widen the spread.
+    float bin_hz = (float)SAMPLE_RATE / DFT_SIZE;
+    check("sine", "centroid", features.centroid, 1236.0f, 0.03f * 1236.0f);
+    check("sine", "spread", features.spread, 1603.0f, 0.05f * 1603.0f);
+    check("sine", "rolloff", features.rolloff, 1000.0f, 2.0f * bin_hz);
+    // Only the sidelobes keep it above 0.
+    check("sine", "flatness", features.flatness, 0.05f, 0.05f);
+    check("sine", "crest", features.crest, 994.0f, 0.1f * 994.0f);
+}
+
+// One of the Audacity test recordings in media/, read like the headless tool
+// does. The expected values were taken from this implementation.
+void check_recording(void) {
+    char const* path = "media/audacity/mushrooms_data/eff/d08/eff08411.au";
+    PcmFile pcm_file = create_pcm_file(path, (struct PcmFormat){0});
+    struct PcmFormat format = format_of_pcm_file(pcm_file);
+    if(format.sample_format != SAMPLE_FORMAT_F32LE || format.channels != 1 || format.sample_rate != SAMPLE_RATE) {
+        printf("  %s is not mono 32-bit float at %d Hz  FAIL\n", path, SAMPLE_RATE);
+        failures++;
+        delete_pcm_file(pcm_file);
+        return;
+    }
+
+    int num_samples = (int)num_samples_of_pcm_file(pcm_file);
+    Pcm pcm = create_pcm(num_samples + DFT_SIZE, format, 0);
+    advance_pcm_file(pcm_file, pcm, num_samples);
+    struct SpectralFeatures features = average_features_of_pcm(pcm);
+    delete_pcm(pcm);
+    delete_pcm_file(pcm_file);
+
+    check("record", "centroid", features.centroid, 3397.0f, 0.01f * 3397.0f);
+    check("record", "rolloff", features.rolloff, 6632.0f, 0.01f * 6632.0f);
+    check("record", "flatness", features.flatness, 0.162f, 0.01f);
+}
+
+void check_silence_and_flux(void) {
+    static float silence[NUM_BINS];
+    static float ramp[NUM_BINS];
+    float ramp_sum = 0.0f;
+    FORI(0, NUM_BINS) {
+        ramp[i] = (float)(i % 16) / 16.0f;
+        ramp_sum += ramp[i];
+    }
+
+    struct SpectralFeatures features;
+    compute_spectral_features(silence, silence, NUM_BINS, 1.0f, &features);
+    float shape = features.flux + features.centroid + features.spread + features.rolloff + features.flatness +
+                  features.crest;
+    check("silence", "all", shape, 0.0f, 0.0f);
+
+    // Half-wave rectified: only increases count.
+    compute_spectral_features(ramp, silence, NUM_BINS, 1.0f, &features);
+    check("ramp", "flux up", features.flux, ramp_sum, 1e-4f * ramp_sum);
+    compute_spectral_features(silence, ramp, NUM_BINS, 1.0f, &features);
+    check("ramp", "flux down", features.flux, 0.0f, 0.0f);
+}
+
+// The SIMD kernels behind `compute_spectral_features` against the scalar loop,
+// over lengths that exercise the tails.
+void check_kernels(float const* magnitudes, float const* previous) {
+    int const lengths[] = {1, 7, 8, 9, 31, 100, NUM_BINS};
+    int const num_lengths = isizeof(lengths) / isizeof(lengths[0]);
+    int kernel_failures = 0;
+    FORI(0, num_lengths) {
+        struct SpectrumSums expected = {0};
+        spectrum_sums_scalar(magnitudes, previous, 0, lengths[i], &expected);
+        struct SpectrumSums sums;
+        spectrum_sums(magnitudes, previous, lengths[i], &sums);
+
+        float const relative = 1e-4f;
+        // The vectorized log2 is good to about 1e-5 per value.
+        float log2_tolerance = 1e-5f * (float)lengths[i] + relative * fabsf(expected.log2_sum);
+        bool ok = fabsf(sums.sum - expected.sum) <= relative * fabsf(expected.sum) &&
+                  fabsf(sums.weighted_sum - expected.weighted_sum) <= relative * fabsf(expected.weighted_sum) &&
+                  fabsf(sums.square_weighted_sum - expected.square_weighted_sum) <=
+                      relative * fabsf(expected.square_weighted_sum) &&
+                  fabsf(sums.log2_sum - expected.log2_sum) <= log2_tolerance &&
+                  fabsf(sums.max - expected.max) <= 0.0f &&
+                  fabsf(sums.rectified_flux - expected.rectified_flux) <= relative * fabsf(expected.rectified_flux);
+        if(!ok) {
+            printf("  kernel  spectrum_sums differs from the scalar loop over %d values  FAIL\n", lengths[i]);
+            kernel_failures++;
+        }
+    }
+    if(kernel_failures == 0) {
+        printf("  kernel  spectrum_sums matches the scalar loop over %d lengths\n", num_lengths);
+    }
+    failures += kernel_failures;
+}
+
+int main(void) {
+    float* samples = ALLOCATE(SAMPLE_RATE, float);
+    float* previous = ALLOCATE(NUM_BINS, float);
+    printf("spectral_features:\n");
+
+    check_white_noise(samples);
+    // Noise samples make fine magnitudes too.
+    FORI(0, NUM_BINS) {
+        samples[i] = fabsf(samples[i]);
+        previous[i] = fabsf(samples[i + NUM_BINS]);
+    }
+    check_kernels(samples, previous);
+    check_sine(samples);
+    check_silence_and_flux();
+    check_recording();
+
+    free(previous);
+    free(samples);
+    printf("spectral_features: %s\n", failures == 0 ? "all within tolerance" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+// Feeds the tempo tracker onset envelopes of known tempo, like the spectral
+// flux of a drum track would look at a 512 sample hop. It has to settle on
+// the tempo with the onsets near phase 0, follow a change of tempo, keep the
+// beat rather than the bar under accents, and report nothing for silence.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "globals.h"
+#include "tempo.h"
+
+#define SAMPLE_RATE 44100
+#define HOP_SIZE 512
+
+static int failures = 0;
+
+void check(char const* signal, char const* field, float value, float expected, float tolerance) {
+    bool ok = fabsf(value - expected) <= tolerance;
+    printf("  %-11s %-10s %8.3f, expected %8.3f +- %g%s\n", signal, field, (double)value, (double)expected,
+           (double)tolerance, ok ? "" : "  FAIL");
+    failures += ok ? 0 : 1;
+}
+
+__attribute__((const)) float hops_per_second(void) { return (float)SAMPLE_RATE / HOP_SIZE; }
+
+// Onset envelope of a beat with some noise between the onsets.
+struct Envelope {
+    uint32_t noise;
+    // Position within the beat and beats so far.
+    float beat_position;
+    int num_beats;
+};
+
+struct Run {
+    struct TempoEstimate estimate;
+    // Mean distance from phase 0 at the onsets of the second half.
+    float onset_phase_error;
+};
+
+// `seconds` of an onset every beat at `bpm`, with every second one `accent`
+// times as strong like a loud snare on 2 and 4.
+void run_tempo(Tempo tempo, float bpm, float accent, float seconds, struct Envelope* envelope, struct Run* run) {
+    int num_hops = (int)(seconds * hops_per_second());
+    float beats_per_hop = bpm / 60.0f / hops_per_second();
+    float error_sum = 0.0f;
+    int num_onsets = 0;
+    FORI(0, num_hops) {
+        envelope->noise ^= envelope->noise << 13;
+        envelope->noise ^= envelope->noise >> 17;
+        envelope->noise ^= envelope->noise << 5;
+        float onset = 0.1f * (float)envelope->noise / (float)UINT32_MAX;
+
+        envelope->beat_position += beats_per_hop;
+        bool is_onset = envelope->beat_position >= 1.0f;
+        if(is_onset) {
+            envelope->beat_position -= 1.0f;
+            envelope->num_beats++;
+            onset += envelope->num_beats % 2 == 0 ? accent : 1.0f;
+        }
+        add_tempo_onset(tempo, onset, &run->estimate);
+
+        if(is_onset && i >= num_hops / 2) {
+            error_sum += MIN(run->estimate.phase, 1.0f - run->estimate.phase);
+            num_onsets++;
+        }
+    }
+    run->onset_phase_error = error_sum / (float)MAX(num_onsets, 1);
+}
+
+int main(void) {
+    printf("tempo_tracking:\n");
+    Tempo tempo = create_tempo(SAMPLE_RATE, HOP_SIZE);
+    struct Envelope envelope = {.noise = 1, .beat_position = 0.0f, .num_beats = 0};
+    struct Run run = {.estimate = {0}};
+
+    // No onsets at all give no estimate.
+    FORI(0, 10 * (int)hops_per_second()) {
+        add_tempo_onset(tempo, 0.0f, &run.estimate);
+    }
+    check("silence", "bpm", run.estimate.bpm, 0.0f, 0.0f);
+    check("silence", "confidence", run.estimate.confidence, 0.0f, 0.0f);
+
+    run_tempo(tempo, 0.0f, 1.0f, 20.0f, &envelope, &run);
+    check("noise", "confidence", run.estimate.confidence, 0.0f, 0.3f);
+
+    run_tempo(tempo, 120.0f, 1.0f, 20.0f, &envelope, &run);
+    check("120 bpm", "bpm", run.estimate.bpm, 120.0f, 1.0f);
+    check("120 bpm", "confidence", run.estimate.confidence, 1.0f, 0.2f);
+    check("120 bpm", "phase", run.onset_phase_error, 0.0f, 0.05f);
+
+    // The switch to another period waits for the old one to fade out, the
+    // phase is still settling after it.
+    run_tempo(tempo, 90.0f, 1.0f, 30.0f, &envelope, &run);
+    check("then 90 bpm", "bpm", run.estimate.bpm, 90.0f, 1.0f);
+    check("then 90 bpm", "confidence", run.estimate.confidence, 1.0f, 0.2f);
+    check("then 90 bpm", "phase", run.onset_phase_error, 0.0f, 0.1f);
+
+    delete_tempo(tempo);
+
+    // Twice the period matches the accents better, it must not win.
+    tempo = create_tempo(SAMPLE_RATE, HOP_SIZE);
+    run_tempo(tempo, 120.0f, 10.0f, 20.0f, &envelope, &run);
+    check("accented", "bpm", run.estimate.bpm, 120.0f, 1.0f);
+    delete_tempo(tempo);
+
+    printf("tempo_tracking: %s\n", failures == 0 ? "all within tolerance" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}